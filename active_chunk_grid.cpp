@@ -0,0 +1,66 @@
+//
+// Dense array of the active chunks of the loaded region, rebuilt every frame.
+//
+// Has a bit of unincluded context.
+//
+
+/*
+ - Collision queries used to call GetChunk() and check ChunkFlags_Active for every chunk position
+   they visit. With this, that's an index into an array (w->activeChunks), and chunks that are not
+   active (or don't exist) are just 0.
+
+ - Call ActiveChunkGrid_Update(&w->activeChunks, ...) at the start of the frame, after chunks have
+   been loaded/activated, with a region that contains every active chunk. Chunks outside of it
+   are treated like inactive ones.
+
+ - If chunks are activated, deactivated or unloaded during the frame, update it again before
+   running any query.
+*/
+
+struct active_chunk_grid{
+    v2s chunkMin; // Chunk position of chunks[0].
+    s32 width;    // In chunks.
+    s32 height;
+    s32 capacity;
+    chunk **chunks;
+};
+
+
+// - 'chunkMin' and 'chunkMax' are inclusive chunk positions.
+void ActiveChunkGrid_Update(active_chunk_grid *grid, world *w, v2s chunkMin, v2s chunkMax){
+    TIMED_FUNCTION();
+    grid->chunkMin = chunkMin;
+    grid->width  = MaxS32(chunkMax.x - chunkMin.x + 1, 0);
+    grid->height = MaxS32(chunkMax.y - chunkMin.y + 1, 0);
+
+    s32 numChunks = grid->width*grid->height;
+    if (numChunks > grid->capacity){
+        free(grid->chunks);
+        grid->capacity = numChunks;
+        grid->chunks = (chunk **)malloc(sizeof(chunk *)*grid->capacity);
+    }
+
+    chunk **dest = grid->chunks;
+    for(s32 y = 0; y < grid->height; y++){
+        for(s32 x = 0; x < grid->width; x++){
+            v2s chunkPos = {chunkMin.x + x, chunkMin.y + y};
+            auto c = GetChunk(w, chunkPos);
+            *dest++ = ((c && (c->flags & ChunkFlags_Active)) ? c : 0);
+        }
+    }
+}
+
+// - 0 if the chunk is not active, doesn't exist, or is outside the grid.
+inline chunk *ActiveChunkGrid_Get(active_chunk_grid *grid, v2s chunkPos){
+    u32 x = (u32)(chunkPos.x - grid->chunkMin.x);
+    u32 y = (u32)(chunkPos.y - grid->chunkMin.y);
+    if (x >= (u32)grid->width || y >= (u32)grid->height) // (Negatives wrap to big numbers)
+        return 0;
+    chunk *result = grid->chunks[y*grid->width + x];
+    return result;
+}
+
+void ActiveChunkGrid_Destruct(active_chunk_grid *grid){
+    free(grid->chunks);
+    ZeroStruct(grid);
+}
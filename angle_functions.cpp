@@ -4,6 +4,7 @@
 
 
 typedef float f32;
+typedef int s32;
 #define PI 3.141592653589793238462f
 #include <math.h>
 
@@ -85,3 +86,249 @@ f32 ClampAngle(f32 a, f32 limit0, f32 limit1){
     }
     return result;
 }
+// - Turns 'angle' towards 'target' (the shortest way) by at most 'maxTurn', and then limits the
+//   result to range 'limit0' to 'limit1' like ClampAngle() (0 and 2*PI mean no limits).
+// - Range [0, 2*PI)
+f32 TurnAngleTowards(f32 angle, f32 target, f32 maxTurn, f32 limit0, f32 limit1){
+    f32 turn = AngleDifference(target, angle);
+    if (turn > maxTurn){
+        turn = maxTurn;
+    }else if (turn < -maxTurn){
+        turn = -maxTurn;
+    }
+    f32 result = ClampAngle(angle + turn, limit0, limit1);
+    return result;
+}
+
+
+
+//
+// Batch versions.
+//
+// - Same range contracts as the functions above, but without fmod or branches: 
+//   a - Floor(a/(2*PI))*(2*PI), and then selects instead of ifs.
+// - 8 angles at a time with AVX2, and the *NoFmod functions for the rest (or for everything if
+//   there's no AVX2). Both do the same operations, so results don't depend on the position in
+//   the array.
+// - 2*PI is split in two parts, which is only exact for small k. So |a| > ANGLE_MAX_NO_FMOD_INPUT
+//   (and inf/NaN) still go through fmod, as slow as the functions above. The AVX2 versions check
+//   that once per 8 angles, and do the 8 with the scalar version if any of them is that big.
+//   Normalized angles, or angles that are normalized now and then, never get there.
+// - Results can differ from the fmod versions by a few ulps. They're never out of range:
+//   NormalizeAngle() can actually return 2*PI for tiny negative angles, these can't.
+// - 'out' can be the same array as any input.
+//
+
+#define TWO_PI_HI 6.28125f          // Few mantissa bits, so k*TWO_PI_HI is exact.
+#define TWO_PI_LO (2*PI - TWO_PI_HI) // The rest of 2*PI (also exact).
+#define ANGLE_MAX_NO_FMOD_INPUT 16384.f
+
+// Range [0, 2*PI)
+inline f32 NormalizeAngleNoFmod(f32 a){
+    if (!(fabsf(a) <= ANGLE_MAX_NO_FMOD_INPUT)){
+        f32 result = fmodf(a, 2*PI);
+        result += (result < 0 ? 2*PI : 0);
+        result -= (result >= 2*PI ? 2*PI : 0);
+        return result;
+    }
+    f32 k = floorf(a*(1.f/(2*PI)));
+    f32 result = (a - k*TWO_PI_HI) - k*TWO_PI_LO;
+    result += (result < 0 ? 2*PI : 0);
+    result -= (result >= 2*PI ? 2*PI : 0);
+    return result;
+}
+
+// Range (-PI, PI]
+inline f32 NormalizeAngleMinusPiPiNoFmod(f32 a){
+    f32 result = NormalizeAngleNoFmod(a);
+    result -= (result > PI ? 2*PI : 0);
+    return result;
+}
+
+// Range (-PI, PI]
+inline f32 AngleDifferenceNoFmod(f32 to, f32 from){
+    f32 result = NormalizeAngleNoFmod(to) - NormalizeAngleNoFmod(from);
+    result -= (result > PI ? 2*PI : 0);
+    result += (result <= -PI ? 2*PI : 0);
+    return result;
+}
+
+inline f32 FlipAngleXNoFmod(f32 angle){
+    angle = NormalizeAngleNoFmod(angle);
+    f32 result = (angle < PI ? PI : PI*3.0f) - angle;
+    return result;
+}
+
+inline f32 ClampAngleNoFmod(f32 a, f32 limit0, f32 limit1){
+    a = NormalizeAngleNoFmod(a);
+    bool unlimited = (limit0 == 0) & (limit1 == 2*PI);
+    limit0 = NormalizeAngleNoFmod(limit0);
+    limit1 = NormalizeAngleNoFmod(limit1);
+
+    bool ascending = (limit0 <= limit1);
+    bool inRange = (ascending ? (a >= limit0) & (a <= limit1) : (a >= limit0) | (a <= limit1));
+    f32 rangeSize = limit1 - limit0 + (ascending ? 0 : 2*PI);
+    f32 closestLimit = (fabsf(AngleDifferenceNoFmod(a, limit0)) <= rangeSize/2.0f ? limit0 : limit1);
+
+    f32 result = (unlimited | inRange ? a : closestLimit);
+    return result;
+}
+
+inline f32 TurnAngleTowardsNoFmod(f32 angle, f32 target, f32 maxTurn, f32 limit0, f32 limit1){
+    f32 turn = AngleDifferenceNoFmod(target, angle);
+    turn = (turn > maxTurn ? maxTurn : turn);
+    turn = (turn < -maxTurn ? -maxTurn : turn);
+    f32 result = ClampAngleNoFmod(angle + turn, limit0, limit1);
+    return result;
+}
+
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+inline __m256 NormalizeAngle8(__m256 a){
+    __m256 twoPi = _mm256_set1_ps(2*PI);
+    __m256 k = _mm256_floor_ps(_mm256_mul_ps(a, _mm256_set1_ps(1.f/(2*PI))));
+    __m256 result = _mm256_sub_ps(a, _mm256_mul_ps(k, _mm256_set1_ps(TWO_PI_HI)));
+    result = _mm256_sub_ps(result, _mm256_mul_ps(k, _mm256_set1_ps(TWO_PI_LO)));
+    result = _mm256_add_ps(result, _mm256_and_ps(_mm256_cmp_ps(result, _mm256_setzero_ps(), _CMP_LT_OQ), twoPi));
+    result = _mm256_sub_ps(result, _mm256_and_ps(_mm256_cmp_ps(result, twoPi, _CMP_GE_OQ), twoPi));
+
+    __m256 big = _mm256_cmp_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.f), a), _mm256_set1_ps(ANGLE_MAX_NO_FMOD_INPUT),
+                               _CMP_NLE_UQ); // (NaN too)
+    if (_mm256_movemask_ps(big)){
+        f32 angles[8];
+        _mm256_storeu_ps(angles, a);
+        for(s32 i = 0; i < 8; i++)
+            angles[i] = NormalizeAngleNoFmod(angles[i]);
+        result = _mm256_loadu_ps(angles);
+    }
+    return result;
+}
+
+inline __m256 NormalizeAngleMinusPiPi8(__m256 a){
+    __m256 result = NormalizeAngle8(a);
+    __m256 tooBig = _mm256_cmp_ps(result, _mm256_set1_ps(PI), _CMP_GT_OQ);
+    result = _mm256_sub_ps(result, _mm256_and_ps(tooBig, _mm256_set1_ps(2*PI)));
+    return result;
+}
+
+inline __m256 AngleDifference8(__m256 to, __m256 from){
+    __m256 twoPi = _mm256_set1_ps(2*PI);
+    __m256 result = _mm256_sub_ps(NormalizeAngle8(to), NormalizeAngle8(from));
+    result = _mm256_sub_ps(result, _mm256_and_ps(_mm256_cmp_ps(result, _mm256_set1_ps(PI), _CMP_GT_OQ), twoPi));
+    result = _mm256_add_ps(result, _mm256_and_ps(_mm256_cmp_ps(result, _mm256_set1_ps(-PI), _CMP_LE_OQ), twoPi));
+    return result;
+}
+
+inline __m256 FlipAngleX8(__m256 angle){
+    angle = NormalizeAngle8(angle);
+    __m256 lowHalf = _mm256_cmp_ps(angle, _mm256_set1_ps(PI), _CMP_LT_OQ);
+    __m256 result = _mm256_sub_ps(_mm256_blendv_ps(_mm256_set1_ps(PI*3.0f), _mm256_set1_ps(PI), lowHalf), angle);
+    return result;
+}
+
+inline __m256 ClampAngle8(__m256 a, __m256 limit0, __m256 limit1){
+    a = NormalizeAngle8(a);
+    __m256 unlimited = _mm256_and_ps(_mm256_cmp_ps(limit0, _mm256_setzero_ps(), _CMP_EQ_OQ),
+                                     _mm256_cmp_ps(limit1, _mm256_set1_ps(2*PI), _CMP_EQ_OQ));
+    limit0 = NormalizeAngle8(limit0);
+    limit1 = NormalizeAngle8(limit1);
+
+    __m256 ascending = _mm256_cmp_ps(limit0, limit1, _CMP_LE_OQ);
+    __m256 aboveLimit0 = _mm256_cmp_ps(a, limit0, _CMP_GE_OQ);
+    __m256 belowLimit1 = _mm256_cmp_ps(a, limit1, _CMP_LE_OQ);
+    __m256 inRange = _mm256_blendv_ps(_mm256_or_ps(aboveLimit0, belowLimit1),
+                                      _mm256_and_ps(aboveLimit0, belowLimit1), ascending);
+    __m256 rangeSize = _mm256_add_ps(_mm256_sub_ps(limit1, limit0),
+                                     _mm256_andnot_ps(ascending, _mm256_set1_ps(2*PI)));
+    __m256 absDifference = _mm256_andnot_ps(_mm256_set1_ps(-0.f), AngleDifference8(a, limit0));
+    __m256 limit0IsCloser = _mm256_cmp_ps(absDifference, _mm256_div_ps(rangeSize, _mm256_set1_ps(2.0f)), _CMP_LE_OQ);
+    __m256 closestLimit = _mm256_blendv_ps(limit1, limit0, limit0IsCloser);
+
+    __m256 result = _mm256_blendv_ps(closestLimit, a, _mm256_or_ps(unlimited, inRange));
+    return result;
+}
+
+inline __m256 TurnAngleTowards8(__m256 angle, __m256 target, __m256 maxTurn, __m256 limit0, __m256 limit1){
+    __m256 turn = AngleDifference8(target, angle);
+    turn = _mm256_min_ps(turn, maxTurn);
+    turn = _mm256_max_ps(turn, _mm256_sub_ps(_mm256_setzero_ps(), maxTurn));
+    __m256 result = ClampAngle8(_mm256_add_ps(angle, turn), limit0, limit1);
+    return result;
+}
+
+#define ANGLE_BATCH_WIDTH 8
+#else
+#define ANGLE_BATCH_WIDTH 0
+#endif
+
+
+void NormalizeAngles(f32 *in, f32 *out, s32 n){
+    s32 i = 0;
+#if ANGLE_BATCH_WIDTH
+    for(; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(out + i, NormalizeAngle8(_mm256_loadu_ps(in + i)));
+#endif
+    for(; i < n; i++)
+        out[i] = NormalizeAngleNoFmod(in[i]);
+}
+
+void NormalizeAnglesMinusPiPi(f32 *in, f32 *out, s32 n){
+    s32 i = 0;
+#if ANGLE_BATCH_WIDTH
+    for(; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(out + i, NormalizeAngleMinusPiPi8(_mm256_loadu_ps(in + i)));
+#endif
+    for(; i < n; i++)
+        out[i] = NormalizeAngleMinusPiPiNoFmod(in[i]);
+}
+
+void AngleDifferences(f32 *to, f32 *from, f32 *out, s32 n){
+    s32 i = 0;
+#if ANGLE_BATCH_WIDTH
+    for(; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(out + i, AngleDifference8(_mm256_loadu_ps(to + i), _mm256_loadu_ps(from + i)));
+#endif
+    for(; i < n; i++)
+        out[i] = AngleDifferenceNoFmod(to[i], from[i]);
+}
+
+void FlipAnglesX(f32 *in, f32 *out, s32 n){
+    s32 i = 0;
+#if ANGLE_BATCH_WIDTH
+    for(; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(out + i, FlipAngleX8(_mm256_loadu_ps(in + i)));
+#endif
+    for(; i < n; i++)
+        out[i] = FlipAngleXNoFmod(in[i]);
+}
+
+void ClampAngles(f32 *a, f32 *limit0, f32 *limit1, f32 *out, s32 n){
+    s32 i = 0;
+#if ANGLE_BATCH_WIDTH
+    for(; i + 8 <= n; i += 8){
+        __m256 result = ClampAngle8(_mm256_loadu_ps(a + i), _mm256_loadu_ps(limit0 + i),
+                                    _mm256_loadu_ps(limit1 + i));
+        _mm256_storeu_ps(out + i, result);
+    }
+#endif
+    for(; i < n; i++)
+        out[i] = ClampAngleNoFmod(a[i], limit0[i], limit1[i]);
+}
+
+// - Batch TurnAngleTowards(), for arrays of rotators (turrets, creatures...).
+// - Use 'limit0' = 0, 'limit1' = 2*PI for the ones that can turn all the way around.
+void TurnAnglesTowards(f32 *angle, f32 *target, f32 *maxTurn, f32 *limit0, f32 *limit1, f32 *out, s32 n){
+    s32 i = 0;
+#if ANGLE_BATCH_WIDTH
+    for(; i + 8 <= n; i += 8){
+        __m256 result = TurnAngleTowards8(_mm256_loadu_ps(angle + i), _mm256_loadu_ps(target + i),
+                                          _mm256_loadu_ps(maxTurn + i), _mm256_loadu_ps(limit0 + i),
+                                          _mm256_loadu_ps(limit1 + i));
+        _mm256_storeu_ps(out + i, result);
+    }
+#endif
+    for(; i < n; i++)
+        out[i] = TurnAngleTowardsNoFmod(angle[i], target[i], maxTurn[i], limit0[i], limit1[i]);
+}
@@ -5,31 +5,307 @@
 // Has a bit of unincluded context.
 //
 
+#include <emmintrin.h>
+
+
+//
+// Telemetry
+//
+// Every call to MixerOutputSound pushes one mixer_telemetry_record into a ring buffer. The
+// mixer is the only writer and a debug overlay or log sink is the only reader, so the ring
+// only needs a write index and a read index, each owned by one side.
+// Off by default: compile with MIXER_TELEMETRY 1 to get it. It costs two __rdtsc() per sound,
+// a few counters, and a walk of the timeout list per call (to count it), so it's meant for
+// development builds.
+//
+#ifndef MIXER_TELEMETRY
+#define MIXER_TELEMETRY 0
+#endif
+
+enum mixer_path{
+    MixerPath_NormalPitchConstantVolume,
+    MixerPath_NormalPitchConstantVolumeLoop,
+    MixerPath_NormalPitchModulatedVolume,
+    MixerPath_CustomPitchConstantVolume,
+    MixerPath_ModulatedPitch,
+
+    MixerPath_Count,
+    MixerPath_None = MixerPath_Count,
+};
+
+struct mixer_telemetry_record{
+    u64 cycles;                         // Whole call.
+    u64 pathCycles[MixerPath_Count];
+    u16 pathVoices[MixerPath_Count];
+    u16 activeVoices;                   // Sounds in the playing list when the call started.
+    u16 delayedVoices;                  // Sounds that only advanced their delay.
+    u16 finishedVoices;                 // Sounds moved to the timeout list by this call.
+    u16 timeoutVoices;                  // Sounds in the timeout list after the call.
+    s32 samplesToWrite;                 // Output samples that will be consumed...
+    s32 samplesWritten;                 // ...out of these.
+    s64 voiceSamplesMixed;              // Sum over sounds of the samples mixed...
+    s64 voiceSamplesConsumed;           // ...and of the ones that weren't extra.
+    s32 clampedSamples;                 // Output samples (L and R count separately) that saturated.
+    b32 underrun;                       // samplesToWrite exceeded the extra samples written by the previous call.
+};
+
+#if MIXER_TELEMETRY
+#define MIXER_TELEMETRY_RING_SIZE 256 // Must be a power of 2.
+
+struct mixer_telemetry_ring{
+    mixer_telemetry_record records[MIXER_TELEMETRY_RING_SIZE];
+    volatile u32 writeIndex; // Only written by the mixer.
+    volatile u32 readIndex;  // Only written by the reader.
+    volatile u32 droppedRecords; // Records lost because the reader didn't drain in time.
+    s32 lastExtraSamples;    // Lookahead written by the previous call.
+};
+
+global_variable mixer_telemetry_ring mixerTelemetry;
+
+// - Called by the mixer. If the ring is full the record is dropped, never blocks.
+void MixerTelemetry_Push(mixer_telemetry_ring *ring, mixer_telemetry_record *record){
+    u32 writeIndex = ring->writeIndex;
+    if (writeIndex - ring->readIndex >= MIXER_TELEMETRY_RING_SIZE){
+        ring->droppedRecords++;
+        return;
+    }
+    ring->records[writeIndex & (MIXER_TELEMETRY_RING_SIZE - 1)] = *record;
+    // Stores aren't reordered with other stores on x86, we just have to stop the compiler.
+    _ReadWriteBarrier();
+    ring->writeIndex = writeIndex + 1;
+}
+
+// - Called by the reader, from any one thread. Copies up to 'maxRecords' records, oldest first.
+// - Returns the number of records copied.
+s32 MixerTelemetry_Drain(mixer_telemetry_ring *ring, mixer_telemetry_record *out, s32 maxRecords){
+    u32 readIndex = ring->readIndex;
+    u32 writeIndex = ring->writeIndex;
+    _ReadWriteBarrier();
+
+    s32 count = 0;
+    while(readIndex != writeIndex && count < maxRecords){
+        out[count++] = ring->records[readIndex & (MIXER_TELEMETRY_RING_SIZE - 1)];
+        readIndex++;
+    }
+    _ReadWriteBarrier();
+    ring->readIndex = readIndex;
+    return count;
+}
+
+#define MixerTelemetry(x) x
+#define MixerTelemetry_BeginPath(p) do{ telemetryPath = (p); telemetry.pathVoices[p]++; telemetryPathStart = __rdtsc(); }while(0)
+#define MixerTelemetry_EndPath() do{ \
+    if (telemetryPath != MixerPath_None){ \
+        telemetry.pathCycles[telemetryPath] += __rdtsc() - telemetryPathStart; \
+        telemetryPath = MixerPath_None; \
+    } \
+}while(0)
+#else
+#define MixerTelemetry(x)
+#define MixerTelemetry_BeginPath(p)
+#define MixerTelemetry_EndPath()
+#endif
+
+
+//
+// Output stage
+//
+// Converts the f32 sum buffer to what the platform wants while applying the master gain.
+// Works on 4 stereo frames (8 samples) at a time with SSE2. Without dither the S16 output is
+// the same as the scalar loop's.
+//
+// - game_sound_output_buffer::format says what 'buffer' holds: stereo s16 frames, or stereo f32
+//   frames (samples in range [-1, 1]) for SoundOutputFormat_F32. 'bufferSize' is its size in
+//   bytes, whatever the format, so an F32 buffer of the same size fits half as many frames.
+// - If audio_state::ditherOutput, s16 output gets TPDF dither. audio_state::ditherSeed is the
+//   state of the noise, 4 xorshift32 lanes that must all be nonzero (lanes that are 0 get a
+//   default seed). The same seed always produces the same output.
+//
+enum sound_output_format{
+    SoundOutputFormat_S16,
+    SoundOutputFormat_F32,
+};
+
+struct mixer_output_gain{
+    f32 gain;   // Of the next frame.
+    f32 target;
+    f32 speed;  // Per frame.
+};
+
+// - Returns the gains of the next 2 frames (as LRLR). Advances the gain one frame at a time like
+//   the scalar loop did, so the results are the same to the bit; it's 2 MoveValueTo per 4 samples.
+inline __m128 MixerOutputNextGains(mixer_output_gain *g){
+    if (g->gain == g->target)
+        return _mm_set1_ps(g->gain);
+    f32 gain0 = g->gain;
+    f32 gain1 = MoveValueTo(gain0, g->target, g->speed);
+    g->gain = MoveValueTo(gain1, g->target, g->speed);
+    __m128 result = _mm_setr_ps(gain0, gain0, gain1, gain1);
+    return result;
+}
+
+inline s32 MixerOutputCountSaturated(__m128 v, __m128 lo, __m128 hi){
+    local_persist u8 bitCounts[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+    s32 mask = _mm_movemask_ps(_mm_or_ps(_mm_cmplt_ps(v, lo), _mm_cmpgt_ps(v, hi)));
+    s32 result = bitCounts[mask];
+    return result;
+}
+
+// - Uniform noise in range [-.5, .5). Advances the 4 xorshift32 lanes in 'seed'.
+inline __m128 MixerOutputUniformNoise(__m128i *seed){
+    __m128i x = *seed;
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+    *seed = x;
+    // Put 23 random bits in the mantissa of a float in range [1, 2).
+    __m128 oneToTwo = _mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(x, 9), _mm_set1_epi32(0x3F800000)));
+    __m128 result = _mm_sub_ps(oneToTwo, _mm_set1_ps(1.5f));
+    return result;
+}
+
+// - Default state of the dither noise, used for the lanes of audio_state::ditherSeed that are 0.
+global_variable u32 mixerDefaultDitherSeed[4] = {0x9E3779B9, 0x7F4A7C15, 0x85EBCA6B, 0xC2B2AE35};
+
+// - 'Dither' is a template parameter so that the block loop doesn't check it (or make noise that
+//   isn't used) for every block.
+template <b32 Dither>
+s32 MixerWriteOutputS16Blocks(s16 *out, f32 *sum, s32 numFrames, mixer_output_gain *gain, __m128i *seed){
+    __m128 lo = _mm_set1_ps(-32768.f);
+    __m128 hi = _mm_set1_ps(32767.f);
+    s32 saturated = 0;
+
+    s32 numFullBlocks = numFrames/4;
+    for(s32 block = 0; block <= numFullBlocks; block++){
+        f32 *src = sum + block*8;
+        s16 *dest = out + block*8;
+        // The last block has less than 4 frames: go through padded locals.
+        f32 tailSrc[8] = {};
+        s16 tailDest[8];
+        s32 tailFrames = numFrames - block*4;
+        if (block == numFullBlocks){
+            if (!tailFrames)
+                break;
+            memcpy(tailSrc, src, tailFrames*2*sizeof(f32));
+            src = tailSrc;
+            dest = tailDest;
+        }
+
+        __m128 v0 = _mm_mul_ps(_mm_loadu_ps(src + 0), MixerOutputNextGains(gain));
+        __m128 v1 = _mm_mul_ps(_mm_loadu_ps(src + 4), MixerOutputNextGains(gain));
+        if (Dither){
+            v0 = _mm_add_ps(v0, _mm_add_ps(MixerOutputUniformNoise(seed), MixerOutputUniformNoise(seed)));
+            v1 = _mm_add_ps(v1, _mm_add_ps(MixerOutputUniformNoise(seed), MixerOutputUniformNoise(seed)));
+        }
+        saturated += MixerOutputCountSaturated(v0, lo, hi) + MixerOutputCountSaturated(v1, lo, hi);
+        // Clamp before converting: out of range floats convert to 0x80000000.
+        v0 = _mm_min_ps(_mm_max_ps(v0, lo), hi);
+        v1 = _mm_min_ps(_mm_max_ps(v1, lo), hi);
+        __m128i packed;
+        if (Dither){
+            // Round to nearest, truncating would bias the dithered signal towards 0.
+            packed = _mm_packs_epi32(_mm_cvtps_epi32(v0), _mm_cvtps_epi32(v1));
+        }else{
+            // Truncate, like the (s16) cast of the scalar version did, so the output is the same.
+            packed = _mm_packs_epi32(_mm_cvttps_epi32(v0), _mm_cvttps_epi32(v1));
+        }
+        _mm_storeu_si128((__m128i *)dest, packed);
+
+        if (dest == tailDest)
+            memcpy(out + block*8, tailDest, tailFrames*2*sizeof(s16));
+    }
+    return saturated;
+}
+
+// - 'numFrames' stereo frames from 'sum' to 'out'. Truncates like an (s16) cast, or if 'dither',
+//   rounds to nearest after adding triangular (TPDF) dither of +-1 LSB.
+// - Every lane of 'ditherSeed' must be nonzero (xorshift stays at 0 forever). Lanes that are 0,
+//   like in a zero-initialized audio_state, are replaced by mixerDefaultDitherSeed.
+// - Returns the number of samples that saturated.
+s32 MixerWriteOutputS16(s16 *out, f32 *sum, s32 numFrames, f32 gain, f32 gainTarget, f32 gainSpeed,
+                        b32 dither, u32 ditherSeed[4]){
+    mixer_output_gain g = {gain, gainTarget, gainSpeed};
+    if (!dither)
+        return MixerWriteOutputS16Blocks<false>(out, sum, numFrames, &g, 0);
+
+    __m128i seed = _mm_loadu_si128((__m128i *)ditherSeed);
+    __m128i zeroLanes = _mm_cmpeq_epi32(seed, _mm_setzero_si128());
+    __m128i defaultSeed = _mm_loadu_si128((__m128i *)mixerDefaultDitherSeed);
+    seed = _mm_or_si128(_mm_andnot_si128(zeroLanes, seed), _mm_and_si128(zeroLanes, defaultSeed));
+
+    s32 saturated = MixerWriteOutputS16Blocks<true>(out, sum, numFrames, &g, &seed);
+    _mm_storeu_si128((__m128i *)ditherSeed, seed);
+    return saturated;
+}
+
+// - 'numFrames' stereo frames from 'sum' to 'out', in range [-1, 1].
+// - Returns the number of samples that saturated.
+s32 MixerWriteOutputF32(f32 *out, f32 *sum, s32 numFrames, f32 gain, f32 gainTarget, f32 gainSpeed){
+    mixer_output_gain g = {gain, gainTarget, gainSpeed};
+    __m128 scale = _mm_set1_ps(1.f/32768.f);
+    __m128 lo = _mm_set1_ps(-1.f);
+    __m128 hi = _mm_set1_ps(1.f);
+    s32 saturated = 0;
+
+    s32 numFullBlocks = numFrames/2;
+    for(s32 block = 0; block < numFullBlocks; block++){
+        __m128 v = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(sum + block*4), MixerOutputNextGains(&g)), scale);
+        saturated += MixerOutputCountSaturated(v, lo, hi);
+        _mm_storeu_ps(out + block*4, _mm_min_ps(_mm_max_ps(v, lo), hi));
+    }
+    if (numFrames & 1){
+        f32 tail[4] = {sum[numFullBlocks*4], sum[numFullBlocks*4 + 1]};
+        __m128 v = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(tail), MixerOutputNextGains(&g)), scale);
+        saturated += MixerOutputCountSaturated(v, lo, hi); // The padding lanes are 0, they never count.
+        _mm_storeu_ps(tail, _mm_min_ps(_mm_max_ps(v, lo), hi));
+        out[numFullBlocks*4]     = tail[0];
+        out[numFullBlocks*4 + 1] = tail[1];
+    }
+    return saturated;
+}
+
+
 void MixerOutputSound(audio_state *state, game_sound_output_buffer *outBuffer, 
                       void *tempMem, s32 tempMemSize){
+    TIMED_FUNCTION();
     // TODO: if this takes too long, consider storing sounds as floats. It'll double the
     // memory but free us from millions of s16->f32 conversions per second.
 
+    MixerTelemetry(mixer_telemetry_record telemetry = {});
+    MixerTelemetry(u64 telemetryStart = __rdtsc());
+    MixerTelemetry(u64 telemetryPathStart = 0);
+    MixerTelemetry(mixer_path telemetryPath = MixerPath_None);
+
     // "Extra" samples are samples that we write in case the next frame lags too much,
     // but if everything goes well we'll overwrite them at the next step.
 
     s32 maxSamplesToWriteWithoutExtra = outBuffer->samplesToWrite;
     // We write an arbitrary number of extra samples.
     // That's gona help us recover when game updates take too long.
+    // Stereo frames that fit in the buffer ('bufferSize' is in bytes).
+    s32 bytesPerFrame = 2*(s32)(outBuffer->format == SoundOutputFormat_F32 ? sizeof(f32) : sizeof(s16));
+    s32 bufferCapacity = outBuffer->bufferSize/bytesPerFrame;
     s32 maxSamplesToWrite = MinS32(maxSamplesToWriteWithoutExtra + (outBuffer->samplesPerSecond/10),
-                                   outBuffer->bufferSize*(s32)sizeof(s16));
+                                   bufferCapacity);
 
     f32 *sumBuffer = (f32 *)tempMem;
     s32 sumBufSize = maxSamplesToWrite*sizeof(f32)*2;
     memset((void *)sumBuffer, 0, sumBufSize);
 
     Assert(sumBufSize <= tempMemSize);
+
+    MixerTelemetry(telemetry.samplesToWrite = maxSamplesToWriteWithoutExtra);
+    MixerTelemetry(telemetry.samplesWritten = maxSamplesToWrite);
+    MixerTelemetry(telemetry.underrun = (maxSamplesToWriteWithoutExtra > mixerTelemetry.lastExtraSamples &&
+                                         mixerTelemetry.lastExtraSamples > 0));
+    MixerTelemetry(mixerTelemetry.lastExtraSamples = maxSamplesToWrite - maxSamplesToWriteWithoutExtra);
     
     playing_sound **prevPtr = &state->firstPlayingSound;
     playing_sound *s        = state->firstPlayingSound;
 
     while(s){
         s->startedPlaying = true;
+        MixerTelemetry(telemetry.activeVoices++);
 
         f32 *sumScan = sumBuffer;
         s32 samplesToWrite = maxSamplesToWrite;
@@ -41,6 +317,7 @@ void MixerOutputSound(audio_state *state, game_sound_output_buffer *outBuffer,
 
         // Sound delay
         if (s->currentSample < 0){
+            s32 delay = -s->currentSample;
             s32 newCurrentSampleWithoutExtra = s->currentSample + samplesToWriteWithoutExtra;
 
             if (newCurrentSampleWithoutExtra < 0){
@@ -48,6 +325,7 @@ void MixerOutputSound(audio_state *state, game_sound_output_buffer *outBuffer,
                 if (newCurrentSample < 0){
                     // There is only delay, no samples.
                     s->currentSample = newCurrentSampleWithoutExtra;
+                    MixerTelemetry(telemetry.delayedVoices++);
                     
                     prevPtr = &s->next;
                     s       = s->next;
@@ -58,7 +336,7 @@ void MixerOutputSound(audio_state *state, game_sound_output_buffer *outBuffer,
                     samplesToWriteWithoutExtra = 0;
                     s->currentSample = newCurrentSampleWithoutExtra;
                     curSample = 0;
-                    sumScan += 2*(-s->currentSample);
+                    sumScan += 2*delay;
                 }
             }else{
                 // There is some delay, then some non-extra samples, then extra samples.
@@ -66,7 +344,7 @@ void MixerOutputSound(audio_state *state, game_sound_output_buffer *outBuffer,
                 samplesToWriteWithoutExtra += s->currentSample;
                 s->currentSample = 0;
                 curSample = 0;
-                sumScan += 2*(-s->currentSample);
+                sumScan += 2*delay;
             }
         }
         Assert(curSample >= 0);
@@ -75,8 +353,19 @@ void MixerOutputSound(audio_state *state, game_sound_output_buffer *outBuffer,
         s32 srcNumChannels = (s32)loadedSound->numChannels;
         s32 srcIsStereo    = (srcNumChannels == 2 ? 1 : 0);
         s32 srcNumSamples  = (s32)loadedSound->numSamples;
-        s16 *srcScan       = loadedSound->mem + (curSample*srcNumChannels);
+        s16 *srcScan;
+
+        // The pitched paths can leave the position past the last sample. Wrap it (or finish the
+        // sound) before any path reads from it, they all count on curSample < srcNumSamples.
+        if (curSample >= srcNumSamples){
+            if (!s->loop) goto LABEL_FinishSound;
+            curSample %= srcNumSamples;
+            s->currentSample = curSample;
+        }
+        srcScan = loadedSound->mem + (curSample*srcNumChannels);
         
+        MixerTelemetry(telemetry.voiceSamplesMixed += samplesToWrite);
+        MixerTelemetry(telemetry.voiceSamplesConsumed += samplesToWriteWithoutExtra);
 
 
         if (s->pitchTarget == s->pitch && s->pitch == 1.0f && 
@@ -84,6 +373,7 @@ void MixerOutputSound(audio_state *state, game_sound_output_buffer *outBuffer,
         {
             if (!s->loop){
 // Constant normal pitch, Constant volume, No loop
+                MixerTelemetry_BeginPath(MixerPath_NormalPitchConstantVolume);
                 int soundSamplesToWrite = MinS32(samplesToWrite,
                                                  (s32)loadedSound->numSamples - curSample);
                 f32 vol[2] = {s->volume[0], s->volume[1]};
@@ -109,6 +399,7 @@ void MixerOutputSound(audio_state *state, game_sound_output_buffer *outBuffer,
                 }
             }else{
 // Constant normal pitch, Constant volume, Loop
+                MixerTelemetry_BeginPath(MixerPath_NormalPitchConstantVolumeLoop);
                 for(s32 written = 0; written < samplesToWrite;){
                     s32 soundSamplesToWrite = MinS32(samplesToWrite - written, srcNumSamples - curSample);
                     for(s32 i = 0; i < soundSamplesToWrite; i++){
@@ -128,6 +419,7 @@ void MixerOutputSound(audio_state *state, game_sound_output_buffer *outBuffer,
             }
         }else if (s->pitchTarget == s->pitch && s->pitch == 1.0f){
 // Constant normal pitch, Modulated volume (loop & no loop)
+            MixerTelemetry_BeginPath(MixerPath_NormalPitchModulatedVolume);
             f32 vol[2] = {s->volume[0], s->volume[1]}; // extra samples volume
             f32 dVolume[2] = {s->dVolume[0], s->dVolume[1]};
             f32 volumeTarget[2] = {s->volumeTarget[0], s->volumeTarget[1]};
@@ -181,6 +473,7 @@ void MixerOutputSound(audio_state *state, game_sound_output_buffer *outBuffer,
                   s->volume[1] == s->volumeTarget[1])
         {
 // Constant custom pitch, Constant volume (loop & no loop)
+            MixerTelemetry_BeginPath(MixerPath_CustomPitchConstantVolume);
             
             f32 pitch = s->pitch;
             AssertRange(.00001f, pitch, 100000.f);
@@ -189,8 +482,12 @@ void MixerOutputSound(audio_state *state, game_sound_output_buffer *outBuffer,
             f32 vol[2] = {s->volume[0], s->volume[1]};
 
             for(s32 written = 0; written < samplesToWrite;){ // This for is only useful if the sound loops.
-                f32 srcSamplesLeft = (f32)(srcNumSamples - curSample) - s->currentSampleFrac;
+                // Output samples whose source position is still inside the sound (at least 1).
+                f32 srcSamplesLeft = (f32)(srcNumSamples - curSample) - curSampleFrac;
                 s32 maxSamplesToWrite = 1 + (s32)Floor(srcSamplesLeft/pitch); // (The 1 is the firstsample at the curSample position)
+                if ((f32)(maxSamplesToWrite - 1)*pitch >= srcSamplesLeft)
+                    maxSamplesToWrite--;
+                s32 lastIndex = srcNumSamples - 1 - curSample; // Of the last sample, from srcScan.
                 s32 soundSamplesToWrite = MinS32(samplesToWrite - written, maxSamplesToWrite);
                 s32 soundSamplesToWriteWithoutExtra = ClampS32(samplesToWriteWithoutExtra - written,
                                                                0, maxSamplesToWrite);
@@ -204,8 +501,12 @@ void MixerOutputSound(audio_state *state, game_sound_output_buffer *outBuffer,
                     s32 carry = (s32)(curSampleFrac + offsetFrac);
                     f32 sampleFrac = curSampleFrac + (offsetFrac - (f32)carry);
 
-                    s16 *sample = srcScan + (srcNumChannels)*((s32)offset + carry);
-                    s16 *nextSample = sample + srcNumChannels;
+                    // The clamp only catches rounding in 'offset'. The last sample lerps to the
+                    // first one if the sound loops, and to itself if it doesn't.
+                    s32 index = MinS32((s32)offset + carry, lastIndex);
+                    s16 *sample = srcScan + (srcNumChannels)*index;
+                    s16 *nextSample = (index < lastIndex ? sample + srcNumChannels :
+                                       (s->loop ? loadedSound->mem : sample));
 
                     *sumScan++ += Lerp((f32)*sample, (f32)*nextSample, sampleFrac)*vol[0];
                     *sumScan++ += Lerp((f32)*(sample + srcIsStereo), (f32)*(nextSample + srcIsStereo), sampleFrac)*vol[1];
@@ -214,20 +515,21 @@ void MixerOutputSound(audio_state *state, game_sound_output_buffer *outBuffer,
                 written += soundSamplesToWrite;
 
                 // Advance non-extra
-                s32 carry = (s32)(s->currentSampleFrac + Frac(soundSamplesToWriteWithoutExtra*pitch));
-                s->currentSample += soundSamplesToWriteWithoutExtra + carry;
-                s->currentSampleFrac = Frac(s->currentSampleFrac + Frac(soundSamplesToWriteWithoutExtra*pitch));
+                f32 advance = soundSamplesToWriteWithoutExtra*pitch;
+                s32 carry = (s32)(s->currentSampleFrac + Frac(advance));
+                s->currentSample += (s32)advance + carry;
+                s->currentSampleFrac = Frac(s->currentSampleFrac + Frac(advance));
 
                 // Advance extra
                 carry = (s32)(curSampleFrac + Frac(offsetLimit));
-                srcScan += (s32)offsetLimit + carry;
+                srcScan += ((s32)offsetLimit + carry)*srcNumChannels;
                 curSample += (s32)offsetLimit + carry;
                 curSampleFrac = Frac(curSampleFrac + Frac(offsetLimit));
 
                 if (s->loop){
                     if (curSample >= srcNumSamples){
                         curSample %= srcNumSamples;
-                        srcScan = loadedSound->mem + curSample;
+                        srcScan = loadedSound->mem + curSample*srcNumChannels;
                         if (s->currentSample >= srcNumSamples)
                             s->currentSample %= srcNumSamples;
                     }
@@ -241,6 +543,7 @@ void MixerOutputSound(audio_state *state, game_sound_output_buffer *outBuffer,
         }else{
 // Modulated pitch (constant & modulated volume) (loop & no loop)
             // @TODO Optimize this maybe
+            MixerTelemetry_BeginPath(MixerPath_ModulatedPitch);
             
             s16 *lastSample = loadedSound->mem + (loadedSound->numSamples - 1)*srcNumChannels;
             s16 *nextSample = loadedSound->mem + ((curSample + 1) % srcNumSamples)*srcNumChannels;
@@ -316,6 +619,7 @@ void MixerOutputSound(audio_state *state, game_sound_output_buffer *outBuffer,
                 pitch = MoveValueTo(pitch, pitchTarget, dPitch);
             }
         }
+        MixerTelemetry_EndPath();
         
 
         if (s->finishIfVolumeGoesTo0 &&
@@ -330,6 +634,8 @@ void MixerOutputSound(audio_state *state, game_sound_output_buffer *outBuffer,
         continue;
 
     LABEL_FinishSound:
+        MixerTelemetry_EndPath();
+        MixerTelemetry(telemetry.finishedVoices++);
         // Remove from Playing Sounds list.
         *prevPtr = s->next;
         // Insert in Timeout Sounds list.
@@ -345,34 +651,33 @@ void MixerOutputSound(audio_state *state, game_sound_output_buffer *outBuffer,
     
     // Write sum to output buffer
     f32 masterGainSpeed = (1.f/41100.f) / .1f; // Used to change the volume softly.
-
-    memset((void *)outBuffer->buffer, 0, outBuffer->bufferSize);
-    s16 *bufScan = outBuffer->buffer;
-    f32 *sumScan = sumBuffer;
-    f32 prevSample = *sumScan;
     f32 gain = state->masterGain;
-    for(int i = 0; i < maxSamplesToWrite; i++){
-        f32 newSample = *sumScan;
-
-        (*bufScan++) = (s16)Clamp((*sumScan++)*gain, -32768.0f, 32767.0f);
-        (*bufScan++) = (s16)Clamp((*sumScan++)*gain, -32768.0f, 32767.0f);
-    
-        gain = MoveValueTo(gain, state->masterGainTarget, masterGainSpeed);
-        if (i < maxSamplesToWriteWithoutExtra){
-            state->masterGain = gain;
-        }
-
-        prevSample = newSample;
+    s32 saturatedSamples;
+    if (outBuffer->format == SoundOutputFormat_F32){
+        saturatedSamples = MixerWriteOutputF32((f32 *)outBuffer->buffer, sumBuffer, maxSamplesToWrite,
+                                               gain, state->masterGainTarget, masterGainSpeed);
+    }else{
+        saturatedSamples = MixerWriteOutputS16(outBuffer->buffer, sumBuffer, maxSamplesToWrite,
+                                               gain, state->masterGainTarget, masterGainSpeed,
+                                               state->ditherOutput, state->ditherSeed);
     }
-     
-    
-    local_persist f32 lastSample =      *(sumBuffer + (maxSamplesToWriteWithoutExtra*2));
-    f32 newLastSample =                 *(sumBuffer + (maxSamplesToWriteWithoutExtra*2));
-    local_persist f32 lastSampleExtra = *(sumBuffer + (maxSamplesToWrite*2));
-    f32 newLastSampleExtra =            *(sumBuffer + (maxSamplesToWrite*2));
-    f32 firstSample = *sumBuffer;
-    lastSample = newLastSample;
+    MixerTelemetry(telemetry.clampedSamples = saturatedSamples);
+    (void)saturatedSamples; // Only used by the telemetry.
+    // Where the gain is after the non-extra samples. Same steps as the writers, so the next call
+    // continues exactly where the scalar loop would.
+    for(s32 i = 0; i < maxSamplesToWriteWithoutExtra && gain != state->masterGainTarget; i++)
+        gain = MoveValueTo(gain, state->masterGainTarget, masterGainSpeed);
+    state->masterGain = gain;
 
     Assert(maxSamplesToWrite < 65536);
     outBuffer->samplesWritten = (u16)maxSamplesToWrite;
+
+#if MIXER_TELEMETRY
+    s32 timeoutVoices = 0;
+    for(playing_sound *timeoutSound = state->firstTimeoutSound; timeoutSound; timeoutSound = timeoutSound->next)
+        timeoutVoices++;
+    telemetry.timeoutVoices = (u16)MinS32(timeoutVoices, 65535);
+    telemetry.cycles = __rdtsc() - telemetryStart;
+    MixerTelemetry_Push(&mixerTelemetry, &telemetry);
+#endif
 }
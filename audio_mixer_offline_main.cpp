@@ -0,0 +1,158 @@
+//
+// Standalone build of the offline mixer scenarios (audio_mixer_offline_render.cpp). Stubs the
+// bits of the game the mixer needs (audio_state, loaded_sound, playing_sound and
+// game_sound_output_buffer, plus the base types and math), so the golden checksums can be
+// checked without the platform layer:
+//
+//     cl /O2 /nologo audio_mixer_offline_main.cpp
+//     g++ -O2 -msse2 -Wno-write-strings audio_mixer_offline_main.cpp -o audio_mixer_offline
+//
+// Add -DMIXER_TELEMETRY=1 to also get the cycles of each mixing path. The exit code is the
+// number of scenarios whose checksum didn't match.
+//
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#define _ReadWriteBarrier() __asm__ __volatile__("" ::: "memory")
+#endif
+
+
+//
+// Base (stub)
+//
+typedef int8_t   s8;
+typedef int16_t  s16;
+typedef int32_t  s32;
+typedef int64_t  s64;
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef float    f32;
+typedef double   f64;
+typedef s32      b32;
+typedef size_t   umm;
+
+#define local_persist   static
+#define global_variable static
+
+#define Assert(expr) do{ if (!(expr)){ fprintf(stderr, "%s(%d): Assert(%s)\n", __FILE__, __LINE__, #expr); abort(); } }while(0)
+#define AssertRange(lo, x, hi) Assert((lo) <= (x) && (x) <= (hi))
+#define ArrayCount(a) ((s32)(sizeof(a)/sizeof((a)[0])))
+#define ZeroStruct(p) memset((p), 0, sizeof(*(p)))
+
+#define TIMED_FUNCTION()
+
+inline s32 MinS32(s32 a, s32 b){ return (a < b ? a : b); }
+inline s32 MaxS32(s32 a, s32 b){ return (a > b ? a : b); }
+inline s32 ClampS32(s32 a, s32 lo, s32 hi){ return (a < lo ? lo : (a > hi ? hi : a)); }
+inline f32 Floor(f32 a){ return floorf(a); }
+inline f32 Frac(f32 a){ return a - (f32)(s32)a; }
+inline f32 Lerp(f32 a, f32 b, f32 t){ return a + (b - a)*t; }
+
+// - Moves 'value' towards 'target' by 'delta' without going past it.
+inline f32 MoveValueTo(f32 value, f32 target, f32 delta){
+    if (value < target){
+        value += delta;
+        if (value > target) value = target;
+    }else if (value > target){
+        value -= delta;
+        if (value < target) value = target;
+    }
+    return value;
+}
+
+
+//
+// Game audio (stub). Only the members the mixer touches.
+//
+#define PLAYING_SOUND_DEFAULT_TIMEOUT_TIME_STEPS 10
+#define OFFLINE_MAX_LOADED_SOUNDS 8
+
+struct loaded_sound{
+    s16 *mem;           // Interleaved if stereo.
+    s32 numSamples;     // Per channel.
+    s32 numChannels;    // 1 or 2.
+};
+
+struct playing_sound{
+    playing_sound *next;
+    b32 startedPlaying;
+    s32 currentSample;  // Negative while delayed.
+    f32 currentSampleFrac;
+    s32 loadedSoundId;
+    f32 pitch, pitchTarget, dPitch;
+    f32 volume[2], volumeTarget[2], dVolume[2];
+    b32 loop;
+    b32 finishIfVolumeGoesTo0;
+    s32 timeoutTimer;
+};
+
+struct audio_state{
+    playing_sound *firstPlayingSound;
+    playing_sound *firstTimeoutSound;
+    f32 masterGain, masterGainTarget;
+    b32 ditherOutput;
+    u32 ditherSeed[4];
+    loaded_sound sounds[OFFLINE_MAX_LOADED_SOUNDS];
+};
+
+inline loaded_sound *SoundIdGetSound(audio_state *state, s32 id){
+    AssertRange(0, id, OFFLINE_MAX_LOADED_SOUNDS - 1);
+    return &state->sounds[id];
+}
+
+struct game_sound_output_buffer{
+    s32 samplesPerSecond;
+    s32 samplesToWrite;
+    s32 bufferSize;     // In bytes.
+    s16 *buffer;
+    u16 samplesWritten;
+    s32 format;         // sound_output_format
+};
+
+
+#include "audio_mixer.cpp"
+#include "audio_mixer_offline_render.cpp"
+
+
+int main(){
+    local_persist audio_state state;
+
+    // Every sound gets its own allocation, so a mixer path that reads past the end of one shows
+    // up in a memory checker instead of reading the next sound.
+    s32 soundIds[MIXER_OFFLINE_NUM_SCENARIO_SOUNDS];
+    for(s32 i = 0; i < MIXER_OFFLINE_NUM_SCENARIO_SOUNDS; i++){
+        s32 numSamples = mixerOfflineScenarioSoundSamples[i];
+        s32 numChannels = mixerOfflineScenarioSoundChannels[i];
+        s16 *mem = (s16 *)malloc((umm)numSamples*numChannels*sizeof(s16));
+        MixerOfflineSynthesizeSound(&state.sounds[i], mem, numSamples, numChannels,
+                                    mixerOfflineScenarioSoundPeriods[i]);
+        soundIds[i] = i;
+    }
+
+    // A second of output is more than a frame plus its extra samples.
+    game_sound_output_buffer outBuffer = {};
+    outBuffer.format = SoundOutputFormat_S16;
+    outBuffer.bufferSize = MIXER_OFFLINE_SCENARIO_SAMPLES_PER_SECOND*2*sizeof(s16);
+    outBuffer.buffer = (s16 *)malloc(outBuffer.bufferSize);
+    s32 tempMemSize = MIXER_OFFLINE_SCENARIO_SAMPLES_PER_SECOND*2*sizeof(f32);
+    void *tempMem = malloc(tempMemSize);
+
+    s32 mismatches = MixerOfflineRunScenarios(&state, soundIds, &outBuffer, tempMem, tempMemSize);
+    printf("%d scenario(s) didn't match.\n", mismatches);
+
+    free(tempMem);
+    free(outBuffer.buffer);
+    for(s32 i = 0; i < MIXER_OFFLINE_NUM_SCENARIO_SOUNDS; i++)
+        free(state.sounds[i].mem);
+    return mismatches;
+}
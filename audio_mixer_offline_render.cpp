@@ -0,0 +1,354 @@
+//
+// Offline driver for MixerOutputSound (audio_mixer.cpp). Renders a scripted scenario frame by
+// frame without the platform layer, so mixer changes can be checked for bit-exactness (by
+// comparing checksums or WAV files) and speed (cycles per voice-sample).
+//
+// Has a bit of unincluded context.
+//
+
+
+// - Called before every mixed frame. Use it to start, stop, fade or bend sounds.
+typedef void mixer_offline_script(audio_state *state, s32 frame, void *userData);
+
+struct mixer_offline_render{
+    // Input
+    s32 samplesPerSecond;
+    s32 samplesPerFrame;    // What the platform would pass in outBuffer->samplesToWrite.
+    s32 numFrames;
+    mixer_offline_script *script;
+    void *scriptUserData;
+
+    // Output. 'samples' must fit numFrames*samplesPerFrame stereo samples.
+    s16 *samples;
+    s32 samplesRendered;
+    u64 checksum;
+    u64 cycles;             // Time spent inside MixerOutputSound.
+    u64 voiceSamples;       // Sum of (playing sounds * samples mixed) over all frames.
+#if MIXER_TELEMETRY
+    // Per mixing path, from the mixer's telemetry records.
+    u64 pathCycles[MixerPath_Count];
+    u64 pathVoiceSamples[MixerPath_Count];
+#endif
+};
+
+// FNV-1a over the raw samples. Any change in the mixer's output changes this.
+u64 MixerOfflineChecksum(s16 *samples, s32 numStereoSamples){
+    u64 hash = 0xCBF29CE484222325;
+    u8 *scan = (u8 *)samples;
+    u8 *end = scan + (umm)numStereoSamples*2*sizeof(s16);
+    while(scan < end){
+        hash ^= *scan++;
+        hash *= 0x100000001B3;
+    }
+    return hash;
+}
+
+// - Fills 'mem' with a deterministic test tone (a triangle wave, so no libm is involved and it
+//   renders the same everywhere).
+// - 'mem' must fit numSamples*numChannels s16s.
+void MixerOfflineSynthesizeSound(loaded_sound *sound, s16 *mem, s32 numSamples, s32 numChannels,
+                                 s32 period){
+    Assert(numChannels == 1 || numChannels == 2);
+    Assert(period >= 2);
+    sound->mem = mem;
+    sound->numSamples = numSamples;
+    sound->numChannels = numChannels;
+    for(s32 i = 0; i < numSamples; i++){
+        s32 phase = (i % period)*4*16000/period;
+        s32 value = (phase < 2*16000 ? phase - 16000 : 3*16000 - phase);
+        for(s32 c = 0; c < numChannels; c++){
+            // Make the right channel a bit different, to catch swapped channels.
+            *mem++ = (s16)(c ? value/2 : value);
+        }
+    }
+}
+
+s32 MixerOfflineCountPlayingSounds(audio_state *state){
+    s32 result = 0;
+    for(playing_sound *s = state->firstPlayingSound; s; s = s->next)
+        result++;
+    return result;
+}
+
+// - Mixes 'numFrames' frames and keeps the non-extra samples of each one, just like the
+//   platform would if every frame arrived in time.
+// - 'tempMem' and 'outBuffer' are the same ones the game would use.
+// - With MIXER_TELEMETRY, this is the reader of mixerTelemetry: it drains it after every frame.
+void MixerRenderOffline(mixer_offline_render *render, audio_state *state,
+                        game_sound_output_buffer *outBuffer, void *tempMem, s32 tempMemSize){
+    Assert(render->samplesPerFrame > 0);
+    Assert(outBuffer->format == SoundOutputFormat_S16);
+    render->samplesRendered = 0;
+    render->cycles = 0;
+    render->voiceSamples = 0;
+#if MIXER_TELEMETRY
+    ZeroStruct(&render->pathCycles);
+    ZeroStruct(&render->pathVoiceSamples);
+    mixer_telemetry_record records[MIXER_TELEMETRY_RING_SIZE];
+    MixerTelemetry_Drain(&mixerTelemetry, records, MIXER_TELEMETRY_RING_SIZE); // Not ours.
+#endif
+
+    s16 *dest = render->samples;
+    for(s32 frame = 0; frame < render->numFrames; frame++){
+        if (render->script)
+            render->script(state, frame, render->scriptUserData);
+
+        outBuffer->samplesPerSecond = render->samplesPerSecond;
+        outBuffer->samplesToWrite = render->samplesPerFrame;
+        s32 numVoices = MixerOfflineCountPlayingSounds(state);
+
+        u64 startCycles = __rdtsc();
+        MixerOutputSound(state, outBuffer, tempMem, tempMemSize);
+        render->cycles += __rdtsc() - startCycles;
+        render->voiceSamples += (u64)numVoices*outBuffer->samplesWritten;
+#if MIXER_TELEMETRY
+        s32 numRecords = MixerTelemetry_Drain(&mixerTelemetry, records, MIXER_TELEMETRY_RING_SIZE);
+        for(s32 i = 0; i < numRecords; i++){
+            for(s32 path = 0; path < MixerPath_Count; path++){
+                render->pathCycles[path] += records[i].pathCycles[path];
+                render->pathVoiceSamples[path] += (u64)records[i].pathVoices[path]*records[i].samplesWritten;
+            }
+        }
+#endif
+
+        Assert(outBuffer->samplesWritten >= render->samplesPerFrame);
+        memcpy(dest, outBuffer->buffer, (umm)render->samplesPerFrame*2*sizeof(s16));
+        dest += render->samplesPerFrame*2;
+        render->samplesRendered += render->samplesPerFrame;
+    }
+    render->checksum = MixerOfflineChecksum(render->samples, render->samplesRendered);
+}
+
+f32 MixerOfflineCyclesPerVoiceSample(mixer_offline_render *render){
+    f32 result = (render->voiceSamples ? (f32)render->cycles/(f32)render->voiceSamples : 0);
+    return result;
+}
+
+#if MIXER_TELEMETRY
+f32 MixerOfflinePathCyclesPerVoiceSample(mixer_offline_render *render, mixer_path path){
+    f32 result = (render->pathVoiceSamples[path] ?
+                  (f32)render->pathCycles[path]/(f32)render->pathVoiceSamples[path] : 0);
+    return result;
+}
+#endif
+
+// - Writes a 16 bit stereo PCM WAV file. Returns false if the file couldn't be written.
+b32 MixerOfflineWriteWav(char *path, s16 *samples, s32 numStereoSamples, s32 samplesPerSecond){
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return false;
+
+    u32 dataSize = (u32)numStereoSamples*2*sizeof(s16);
+    u32 header[11] = {
+        0x46464952,                  // "RIFF"
+        36 + dataSize,
+        0x45564157,                  // "WAVE"
+        0x20746D66,                  // "fmt "
+        16,
+        (2 << 16) | 1,               // PCM, 2 channels
+        (u32)samplesPerSecond,
+        (u32)(samplesPerSecond*2*sizeof(s16)),
+        (u32)((16 << 16) | (2*sizeof(s16))), // 16 bits per sample, block align
+        0x61746164,                  // "data"
+        dataSize,
+    };
+    b32 ok = (fwrite(header, sizeof(header), 1, file) == 1 &&
+              fwrite(samples, dataSize, 1, file) == 1);
+    ok = (fclose(file) == 0) && ok;
+    return ok;
+}
+
+
+//
+// Scenarios
+//
+// Scripted renders with known checksums. Each one starts 'numVoices' sounds made to go through
+// one path of the mixer (the last one mixes all of them), with loops, delays, pitch sweeps and
+// volume fades, and checks the result against the golden checksum in the table.
+//
+// - If a mixer change is meant to change the output, put the new checksums in the table:
+//   MixerOfflineRunScenarios() prints them.
+// - The checksums are of the S16 output without dither, at 48000Hz with 800 samples per frame,
+//   with the sounds of MixerOfflineSynthesizeScenarioSounds().
+// - audio_mixer_offline_main.cpp runs them without the game, with stubs for its audio types.
+//
+
+enum mixer_offline_voice_flags{
+    MixerOfflineVoice_Loop        = 0x1,
+    MixerOfflineVoice_Delay       = 0x2,  // Staggered starts, some of them longer than a frame.
+    MixerOfflineVoice_CustomPitch = 0x4,  // Constant pitch that isn't 1.
+    MixerOfflineVoice_PitchSweep  = 0x8,  // Pitch moves towards double or half.
+    MixerOfflineVoice_VolumeFade  = 0x10, // Volume pans across, then fades out halfway through.
+    MixerOfflineVoice_Mixed       = 0x20, // Every voice gets a different mix of the flags above.
+};
+
+struct mixer_offline_scenario{
+    char *name;
+    s32 numVoices;
+    u32 voiceFlags;
+    u64 expectedChecksum;
+};
+
+global_variable mixer_offline_scenario mixerOfflineScenarios[] = {
+    {"normal pitch, constant volume",        16, MixerOfflineVoice_Delay,                               0x3C14F8B9F0084CE5},
+    {"normal pitch, constant volume, loop",  16, MixerOfflineVoice_Loop|MixerOfflineVoice_Delay,        0x35AEB63E99374BC3},
+    {"normal pitch, volume fade",            16, MixerOfflineVoice_VolumeFade|MixerOfflineVoice_Loop,    0x07EFA176A566F8FB},
+    {"custom pitch, constant volume",        16, MixerOfflineVoice_CustomPitch|MixerOfflineVoice_Delay,  0x074035176AEAA2DA},
+    {"pitch sweep",                          16, MixerOfflineVoice_PitchSweep|MixerOfflineVoice_Loop,    0x4C38F1B48F7B992A},
+    {"pitch sweep, volume fade",             16, (MixerOfflineVoice_PitchSweep|MixerOfflineVoice_VolumeFade|
+                                                 MixerOfflineVoice_CustomPitch|MixerOfflineVoice_Delay), 0xF62B995AE2FEDEF6},
+    {"everything",                           64, MixerOfflineVoice_Mixed,                               0xC9098FC0EDAC4EAE},
+};
+
+#define MIXER_OFFLINE_SCENARIO_SAMPLES_PER_SECOND 48000
+#define MIXER_OFFLINE_SCENARIO_SAMPLES_PER_FRAME  800
+#define MIXER_OFFLINE_SCENARIO_NUM_FRAMES         120
+#define MIXER_OFFLINE_NUM_SCENARIO_SOUNDS         4
+
+global_variable s32 mixerOfflineScenarioSoundSamples[MIXER_OFFLINE_NUM_SCENARIO_SOUNDS]  = {48000, 30011, 20000, 7919};
+global_variable s32 mixerOfflineScenarioSoundChannels[MIXER_OFFLINE_NUM_SCENARIO_SOUNDS] = {1, 2, 1, 2};
+global_variable s32 mixerOfflineScenarioSoundPeriods[MIXER_OFFLINE_NUM_SCENARIO_SOUNDS]  = {100, 73, 441, 17};
+
+s32 MixerOfflineScenarioSoundsMemSize(){
+    s32 result = 0;
+    for(s32 i = 0; i < MIXER_OFFLINE_NUM_SCENARIO_SOUNDS; i++)
+        result += mixerOfflineScenarioSoundSamples[i]*mixerOfflineScenarioSoundChannels[i];
+    return result;
+}
+
+// - 'mem' must fit MixerOfflineScenarioSoundsMemSize() s16s.
+// - The game has to register these sounds (so that SoundIdGetSound() finds them) and pass their
+//   ids to MixerOfflineRunScenarios().
+void MixerOfflineSynthesizeScenarioSounds(loaded_sound *sounds, s16 *mem){
+    for(s32 i = 0; i < MIXER_OFFLINE_NUM_SCENARIO_SOUNDS; i++){
+        MixerOfflineSynthesizeSound(&sounds[i], mem, mixerOfflineScenarioSoundSamples[i],
+                                    mixerOfflineScenarioSoundChannels[i], mixerOfflineScenarioSoundPeriods[i]);
+        mem += mixerOfflineScenarioSoundSamples[i]*mixerOfflineScenarioSoundChannels[i];
+    }
+}
+
+struct mixer_offline_scenario_state{
+    mixer_offline_scenario *scenario;
+    playing_sound *voices;
+    s32 *soundIds;
+    s32 numFrames;
+};
+
+inline u32 MixerOfflineVoiceFlags(mixer_offline_scenario *scenario, s32 voiceIndex){
+    if (!(scenario->voiceFlags & MixerOfflineVoice_Mixed))
+        return scenario->voiceFlags;
+    // Walks through every combination (the flags are the low 5 bits).
+    u32 result = ((u32)voiceIndex*7) & 0x1F;
+    return result;
+}
+
+void MixerOfflineScenarioScript(audio_state *state, s32 frame, void *userData){
+    mixer_offline_scenario_state *scenarioState = (mixer_offline_scenario_state *)userData;
+    mixer_offline_scenario *scenario = scenarioState->scenario;
+
+    if (frame == 0){
+        // The sum of all voices stays in range, so the checksums don't depend on the clamping.
+        f32 volumeScale = 1.f/(f32)scenario->numVoices;
+        for(s32 i = 0; i < scenario->numVoices; i++){
+            u32 flags = MixerOfflineVoiceFlags(scenario, i);
+            playing_sound *s = &scenarioState->voices[i];
+            ZeroStruct(s);
+            s->loadedSoundId = scenarioState->soundIds[i % MIXER_OFFLINE_NUM_SCENARIO_SOUNDS];
+            s->loop = ((flags & MixerOfflineVoice_Loop) != 0);
+            if (flags & MixerOfflineVoice_Delay)
+                s->currentSample = -((i*1237) % 3000);
+
+            s->pitch = 1.f;
+            if (flags & MixerOfflineVoice_CustomPitch)
+                s->pitch = .375f + .25f*(f32)(i % 5); // Never 1.
+            s->pitchTarget = s->pitch;
+            if (flags & MixerOfflineVoice_PitchSweep){
+                s->pitchTarget = s->pitch*((i & 1) ? 2.f : .5f);
+                s->dPitch = .00002f*(f32)(1 + i % 3);
+            }
+
+            s->volume[0] = volumeScale*(.6f + .1f*(f32)(i % 5));
+            s->volume[1] = volumeScale*(.6f + .1f*(f32)((i + 2) % 5));
+            s->volumeTarget[0] = s->volume[0];
+            s->volumeTarget[1] = s->volume[1];
+            if (flags & MixerOfflineVoice_VolumeFade){
+                s->volumeTarget[0] = s->volume[1];
+                s->volumeTarget[1] = s->volume[0];
+                s->dVolume[0] = s->dVolume[1] = volumeScale*.00001f;
+            }
+
+            s->next = state->firstPlayingSound;
+            state->firstPlayingSound = s;
+        }
+    }
+
+    if (frame == scenarioState->numFrames/2){
+        for(playing_sound *s = state->firstPlayingSound; s; s = s->next){
+            s32 voiceIndex = (s32)(s - scenarioState->voices);
+            if (!(MixerOfflineVoiceFlags(scenario, voiceIndex) & MixerOfflineVoice_VolumeFade))
+                continue;
+            s->volumeTarget[0] = s->volumeTarget[1] = 0;
+            s->dVolume[0] = s->dVolume[1] = (s->volume[0] + s->volume[1])/20000.f;
+            s->finishIfVolumeGoesTo0 = true;
+        }
+    }
+}
+
+// - Renders every scenario of mixerOfflineScenarios and prints its checksum and timing.
+// - 'state' must not have playing sounds. Its playing and timeout lists are emptied after each
+//   scenario, and its master gain and dither are reset.
+// - 'soundIds': ids of the sounds made with MixerOfflineSynthesizeScenarioSounds(), in order.
+// - Returns the number of scenarios whose checksum didn't match.
+s32 MixerOfflineRunScenarios(audio_state *state, s32 *soundIds, game_sound_output_buffer *outBuffer,
+                             void *tempMem, s32 tempMemSize){
+    s32 maxVoices = 0;
+    for(s32 i = 0; i < ArrayCount(mixerOfflineScenarios); i++)
+        maxVoices = MaxS32(maxVoices, mixerOfflineScenarios[i].numVoices);
+
+    mixer_offline_render render = {};
+    render.samplesPerSecond = MIXER_OFFLINE_SCENARIO_SAMPLES_PER_SECOND;
+    render.samplesPerFrame = MIXER_OFFLINE_SCENARIO_SAMPLES_PER_FRAME;
+    render.numFrames = MIXER_OFFLINE_SCENARIO_NUM_FRAMES;
+    render.script = MixerOfflineScenarioScript;
+    render.samples = (s16 *)malloc((umm)render.numFrames*render.samplesPerFrame*2*sizeof(s16));
+    playing_sound *voices = (playing_sound *)malloc(sizeof(playing_sound)*maxVoices);
+
+    s32 mismatches = 0;
+    for(s32 i = 0; i < ArrayCount(mixerOfflineScenarios); i++){
+        mixer_offline_scenario *scenario = &mixerOfflineScenarios[i];
+        Assert(!state->firstPlayingSound);
+        state->masterGain = state->masterGainTarget = 1.f;
+        state->ditherOutput = false;
+
+        mixer_offline_scenario_state scenarioState = {scenario, voices, soundIds, render.numFrames};
+        render.scriptUserData = &scenarioState;
+        MixerRenderOffline(&render, state, outBuffer, tempMem, tempMemSize);
+
+        state->firstPlayingSound = 0;
+        state->firstTimeoutSound = 0;
+
+        b32 matches = (render.checksum == scenario->expectedChecksum);
+        if (!matches)
+            mismatches++;
+        printf("%-40s 0x%016llX %s  %.2f cycles/voice-sample\n", scenario->name,
+               (unsigned long long)render.checksum, (matches ? "ok      " : "MISMATCH"),
+               MixerOfflineCyclesPerVoiceSample(&render));
+#if MIXER_TELEMETRY
+        local_persist char *pathNames[MixerPath_Count] = {
+            "NormalPitchConstantVolume", "NormalPitchConstantVolumeLoop", "NormalPitchModulatedVolume",
+            "CustomPitchConstantVolume", "ModulatedPitch",
+        };
+        for(s32 path = 0; path < MixerPath_Count; path++){
+            if (!render.pathVoiceSamples[path])
+                continue;
+            printf("    %-32s %10llu voice-samples %8.2f cycles/voice-sample\n", pathNames[path],
+                   (unsigned long long)render.pathVoiceSamples[path],
+                   MixerOfflinePathCyclesPerVoiceSample(&render, (mixer_path)path));
+        }
+#endif
+    }
+
+    free(voices);
+    free(render.samples);
+    return mismatches;
+}
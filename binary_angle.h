@@ -0,0 +1,192 @@
+//
+// Binary angles
+//
+// Has a tiny bit of unincluded context.
+//
+
+/*
+ - A binary_angle stores an angle as a u32 where 2^32 is a full turn, so wrapping around is
+   just integer overflow and there's nothing to normalize. Everything here is integer math
+   (except the conversions to/from radians), so it gives the same results with any compiler,
+   which is what we need for lockstep replays.
+
+ - A full turn is 2*PI with the same f32 PI as angle_functions.cpp, so converting a radians
+   value normalized with NormalizeAngle() and back gives that same value (within an ulp).
+
+ - Mirrors the f32 functions:
+     NormalizeAngle          -> nothing to do (BinaryAngle_ToRadians gives [0, 2*PI))
+     NormalizeAngleMinusPiPi -> BinaryAngle_ToRadiansMinusPiPi
+     AngleDifference         -> BinaryAngle_Difference
+     FlipAngleX              -> BinaryAngle_FlipX
+     ClampAngle              -> BinaryAngle_Clamp / BinaryAngle_ClampToArc
+
+ - There's no 2*PI (it wraps to 0), so ClampAngle(a, 0, 2*PI) ("any angle") can't be written
+   with two limits. Use BinaryAngle_ClampToArc(a, start, BINARY_ANGLE_FULL_ARC) instead.
+*/
+
+struct binary_angle{
+    u32 bits;
+};
+
+#define BINARY_ANGLE_PI       0x80000000u
+#define BINARY_ANGLE_HALF_PI  0x40000000u
+#define BINARY_ANGLE_FULL_ARC 0xFFFFFFFFu // Arc length that contains every angle.
+
+// Radians per unit, computed in f64 so conversions round only once.
+#define BINARY_ANGLE_RADIANS_PER_UNIT ((double)(2*PI)/4294967296.0)
+
+
+// - Any finite value works, it wraps around. Inf and NaN give 0.
+// - Rounds to the nearest unit. Past |radians| ~1.3e7 the f64 division is already off by more than
+//   a unit, but it's still deterministic.
+constexpr binary_angle BinaryAngle_FromRadians(f32 radians){
+    double units = (double)radians/BINARY_ANGLE_RADIANS_PER_UNIT;
+    // Take out the whole turns first, so the s64 cast can't overflow. (No fmod or floor: they're
+    // not constexpr.)
+    double turns = units/4294967296.0; // Exact.
+    if (!(turns > -4503599627370496.0 && turns < 4503599627370496.0)){
+        units = 0; // |turns| >= 2^52: a whole number of turns (or inf/NaN).
+    }else{
+        units -= (double)(s64)turns*4294967296.0; // Exact, leaves (-2^32, 2^32).
+    }
+    s64 rounded = (s64)(units + (units >= 0 ? .5 : -.5));
+    binary_angle result = {(u32)(u64)rounded}; // Modulo 2^32.
+    return result;
+}
+
+// Range [0, 2*PI)
+constexpr f32 BinaryAngle_ToRadians(binary_angle a){
+    f32 result = (f32)((double)a.bits*BINARY_ANGLE_RADIANS_PER_UNIT);
+    // The angles right below a full turn round up to 2*PI.
+    return (result >= 2*PI ? 0 : result);
+}
+
+// Range (-PI, PI]
+constexpr f32 BinaryAngle_ToRadiansMinusPiPi(binary_angle a){
+    f32 result = (f32)((double)(s32)a.bits*BINARY_ANGLE_RADIANS_PER_UNIT);
+    return (result <= -PI ? PI : result);
+}
+
+inline binary_angle BinaryAngle_Add(binary_angle a, s32 delta){
+    binary_angle result = {a.bits + (u32)delta};
+    return result;
+}
+
+// - Returns the angle that you would have to add to the direction 'from' to get to direction 'to'.
+// - Range [-PI, PI): unlike AngleDifference(), opposite directions give -PI (S32_MIN), because PI
+//   doesn't fit in an s32.
+inline s32 BinaryAngle_Difference(binary_angle to, binary_angle from){
+    s32 result = (s32)(to.bits - from.bits);
+    return result;
+}
+
+// - Flips the angle horizontally.
+inline binary_angle BinaryAngle_FlipX(binary_angle a){
+    binary_angle result = {BINARY_ANGLE_PI - a.bits};
+    return result;
+}
+
+// - Limits 'a' to the arc that starts at 'start' and goes 'arcLength' units in ascending direction.
+// - If 'arcLength' == 0 the only result will be 'start'.
+// - If 'arcLength' == BINARY_ANGLE_FULL_ARC the result can be any angle.
+// - Out of range angles go to the closest end, with the same rule as ClampAngle().
+inline binary_angle BinaryAngle_ClampToArc(binary_angle a, binary_angle start, u32 arcLength){
+    u32 offset = a.bits - start.bits;
+    if (offset <= arcLength) // In range
+        return a;
+
+    s32 differenceToStart = BinaryAngle_Difference(a, start);
+    u32 distanceToStart = (differenceToStart < 0 ? 0u - (u32)differenceToStart : (u32)differenceToStart);
+    binary_angle result = {(distanceToStart <= arcLength/2 ? start.bits : start.bits + arcLength)};
+    return result;
+}
+
+// - Limits 'a' to range 'limit0' to 'limit1' in ascending direction.
+// - If 'limit0' == 'limit1' the only result will be that limit.
+inline binary_angle BinaryAngle_Clamp(binary_angle a, binary_angle limit0, binary_angle limit1){
+    binary_angle result = BinaryAngle_ClampToArc(a, limit0, limit1.bits - limit0.bits);
+    return result;
+}
+
+// - Goes from 'a' to 'b' through the shortest way.
+// - 't' is in 16.16 fixed point: 0 gives 'a', 65536 gives 'b'.
+inline binary_angle BinaryAngle_Lerp(binary_angle a, binary_angle b, u32 t){
+    Assert(t <= 65536);
+    s64 delta = (s64)BinaryAngle_Difference(b, a);
+    binary_angle result = {a.bits + (u32)(s32)((delta*(s64)t) >> 16)};
+    return result;
+}
+
+
+
+//
+// Sin/Cos
+//
+// Table of sin() in 2.30 fixed point at BINARY_ANGLE_SIN_TABLE_SIZE points of a full turn
+// (+1 so that we can always read the next entry). The top bits of the angle are the index,
+// and the rest interpolate linearly between two entries.
+// - Max error is about 4.7e-6 (the linear interpolation; the fixed point rounding is 1e-9).
+// - The table is built at compile time with f64 adds and multiplies only, so it's bit-identical
+//   with any compiler.
+//
+
+#define BINARY_ANGLE_SIN_TABLE_BITS 10
+#define BINARY_ANGLE_SIN_TABLE_SIZE (1 << BINARY_ANGLE_SIN_TABLE_BITS)
+#define BINARY_ANGLE_SIN_FRAC_BITS  (32 - BINARY_ANGLE_SIN_TABLE_BITS)
+#define BINARY_ANGLE_ONE_Q30 (1 << 30)
+
+struct binary_angle_sin_table{
+    s32 values[BINARY_ANGLE_SIN_TABLE_SIZE + 1];
+};
+
+constexpr binary_angle_sin_table BinaryAngle_MakeSinTable(){
+    binary_angle_sin_table table = {};
+    for(s32 i = 0; i <= BINARY_ANGLE_SIN_TABLE_SIZE; i++){
+        // Use the symmetries to only evaluate [0, PI/2], where the Taylor series converges fast.
+        s32 halfTurn = BINARY_ANGLE_SIN_TABLE_SIZE/2;
+        s32 j = i % halfTurn;
+        if (j > halfTurn/2)
+            j = halfTurn - j;
+        double x = (double)j*(2*3.14159265358979323846/BINARY_ANGLE_SIN_TABLE_SIZE);
+
+        double term = x;
+        double sum = x;
+        for(s32 n = 1; n < 12; n++){
+            term *= -x*x/(double)((2*n)*(2*n + 1));
+            sum += term;
+        }
+        if ((i / halfTurn) & 1)
+            sum = -sum;
+
+        double scaled = sum*(double)BINARY_ANGLE_ONE_Q30;
+        table.values[i] = (s32)(scaled + (scaled >= 0 ? .5 : -.5));
+    }
+    return table;
+}
+
+constexpr binary_angle_sin_table binaryAngleSinTable = BinaryAngle_MakeSinTable();
+
+// - 2.30 fixed point, range [-2^30, 2^30].
+inline s32 BinaryAngle_SinQ30(binary_angle a){
+    u32 index = a.bits >> BINARY_ANGLE_SIN_FRAC_BITS;
+    s64 frac  = (s64)(a.bits & ((1u << BINARY_ANGLE_SIN_FRAC_BITS) - 1));
+    s32 s0 = binaryAngleSinTable.values[index];
+    s32 s1 = binaryAngleSinTable.values[index + 1];
+    s32 result = s0 + (s32)(((s64)(s1 - s0)*frac) >> BINARY_ANGLE_SIN_FRAC_BITS);
+    return result;
+}
+
+inline s32 BinaryAngle_CosQ30(binary_angle a){
+    s32 result = BinaryAngle_SinQ30(BinaryAngle_Add(a, BINARY_ANGLE_HALF_PI));
+    return result;
+}
+
+inline f32 BinaryAngle_Sin(binary_angle a){
+    f32 result = (f32)BinaryAngle_SinQ30(a)*(1.f/BINARY_ANGLE_ONE_Q30);
+    return result;
+}
+
+inline f32 BinaryAngle_Cos(binary_angle a){
+    f32 result = (f32)BinaryAngle_CosQ30(a)*(1.f/BINARY_ANGLE_ONE_Q30);
+    return result;
+}
@@ -0,0 +1,112 @@
+//
+// Per-chunk index of entity positions, split by entity type.
+//
+// Has a lot of unincluded context.
+//
+
+/*
+ - Queries that only care about one entity_type (like EntityMovingCircleCollision) used to walk
+   every entity of c->hotEntities and read e->type, e->flags and e->pos, pulling whole entity
+   structs of every type through the cache. With this they scan compact x/y arrays of only the
+   type they want, and only touch the entity itself when the position passes the test.
+
+ - Each chunk has a chunk_entity_index (c->entityIndex), with SoA arrays per entity_type.
+   Entities know their slot in it (e->entityIndexSlot).
+
+ - It has to be kept in sync with the chunk's entities by whoever changes them:
+     - Entity added to the chunk (spawned, or moved from another chunk):   ChunkEntityIndex_Add
+     - Entity removed from the chunk (deleted, or moved to another chunk): ChunkEntityIndex_Remove
+     - Entity moved inside the chunk:                                      ChunkEntityIndex_UpdatePos
+     - Entity struct moved in memory (e.g. blocks being compacted):        ChunkEntityIndex_Relocate
+   Entities flagged EntityFlags_RemoveAtEndOfFrame stay in the index until they're actually
+   removed, so queries still have to check the flag (only on hits, which is cheap).
+*/
+
+struct chunk_entity_type_index{
+    s32 count;
+    s32 capacity;   // Always a multiple of 8, so 8-wide loads never go past the end.
+    s32 *x;
+    s32 *y;
+    u64 *eid;
+    entity **entities; // Only read when a position passes a test.
+};
+
+struct chunk_entity_index{
+    chunk_entity_type_index types[EntityType_Count];
+};
+
+
+void ChunkEntityTypeIndex_Grow(chunk_entity_type_index *index){
+    s32 newCapacity = MaxS32(index->capacity*2, 16);
+    umm elementSize = sizeof(s32)*2 + sizeof(u64) + sizeof(entity *);
+    u8 *mem = (u8 *)malloc(elementSize*newCapacity);
+
+    // u64s and pointers first, so everything stays aligned.
+    u64 *eid = (u64 *)mem;
+    entity **entities = (entity **)(eid + newCapacity);
+    s32 *x = (s32 *)(entities + newCapacity);
+    s32 *y = x + newCapacity;
+    if (index->count){
+        memcpy(eid,      index->eid,      sizeof(u64)*index->count);
+        memcpy(entities, index->entities, sizeof(entity *)*index->count);
+        memcpy(x,        index->x,        sizeof(s32)*index->count);
+        memcpy(y,        index->y,        sizeof(s32)*index->count);
+    }
+    free(index->eid); // (The start of the old block)
+
+    index->eid = eid;
+    index->entities = entities;
+    index->x = x;
+    index->y = y;
+    index->capacity = newCapacity;
+}
+
+void ChunkEntityIndex_Add(chunk *c, entity *e){
+    chunk_entity_type_index *index = &c->entityIndex.types[e->type];
+    if (index->count == index->capacity)
+        ChunkEntityTypeIndex_Grow(index);
+
+    s32 slot = index->count++;
+    index->x[slot] = e->pos.x;
+    index->y[slot] = e->pos.y;
+    index->eid[slot] = e->eid;
+    index->entities[slot] = e;
+    e->entityIndexSlot = slot;
+}
+
+void ChunkEntityIndex_Remove(chunk *c, entity *e){
+    chunk_entity_type_index *index = &c->entityIndex.types[e->type];
+    s32 slot = e->entityIndexSlot;
+    Assert(slot < index->count && index->entities[slot] == e);
+
+    // Move the last one to the hole.
+    s32 last = --index->count;
+    if (slot != last){
+        index->x[slot] = index->x[last];
+        index->y[slot] = index->y[last];
+        index->eid[slot] = index->eid[last];
+        index->entities[slot] = index->entities[last];
+        index->entities[slot]->entityIndexSlot = slot;
+    }
+}
+
+inline void ChunkEntityIndex_UpdatePos(chunk *c, entity *e){
+    chunk_entity_type_index *index = &c->entityIndex.types[e->type];
+    Assert(index->entities[e->entityIndexSlot] == e);
+    index->x[e->entityIndexSlot] = e->pos.x;
+    index->y[e->entityIndexSlot] = e->pos.y;
+}
+
+// - 'e' is the new address of an entity that was already in the index.
+inline void ChunkEntityIndex_Relocate(chunk *c, entity *e){
+    chunk_entity_type_index *index = &c->entityIndex.types[e->type];
+    Assert(index->eid[e->entityIndexSlot] == e->eid);
+    index->entities[e->entityIndexSlot] = e;
+}
+
+void ChunkEntityIndex_Destruct(chunk *c){
+    for(s32 type = 0; type < EntityType_Count; type++){
+        free(c->entityIndex.types[type].eid);
+    }
+    ZeroStruct(&c->entityIndex);
+}
@@ -48,3 +48,283 @@ b32 CircleWallCollision(wall *w, v2s center, s32 radius){
     }
     return true;
 }
+
+
+// - Moves a circle with 'radius' from 'p0' to 'p1' and finds when it first touches the wall.
+// - Returns false if it doesn't. Otherwise:
+//     'outT': time of impact, from 0 (at 'p0') to 1 (at 'p1').
+//     'outContact': point of the wall that the circle touches.
+//     'outNormal': unit normal of the wall at that point (one of w->normals, or the direction
+//                  from a vertex to the center of the circle).
+// - If the circle already collides at 'p0', 'outT' is 0 and the normal is the one of the closest
+//   feature (the edge it's over, or the vertex it's touching).
+// - Same decomposition as CircleWallCollision(): the triangle grown by 'radius' is the triangle,
+//   plus a rectangle outwards from each edge, plus a circle at each vertex. We move the center
+//   against that shape: the first hit is either on the outer side of a rectangle or on a circle.
+b32 CircleWallSweep(wall *w, v2s p0, v2s p1, s32 radius, f32 *outT, v2 *outContact, v2 *outNormal){
+    TIMED_FUNCTION();
+    // Everything relative to p0.
+    v2 t[3] = {V2(w->p[0] - p0), V2(w->p[1] - p0), V2(w->p[2] - p0)};
+    v2 n[3] = {w->normals[0], w->normals[1], w->normals[2]};
+    v2 d = V2(p1 - p0);
+    f32 r = (f32)radius;
+    v2 o = V2(0);
+
+    if (CircleWallCollision(w, p0, radius)){
+        // Find the feature we're over, with the same tests as CircleWallCollision().
+        b32 insideTriangle = true;
+        s32 closestEdge = 0;
+        f32 closestEdgeProj = -FLT_MAX;
+        for(s32 i = 0; i < 3; i++){
+            f32 proj = Dot(n[i], o - t[i]);
+            if (proj > closestEdgeProj){
+                closestEdge = i;
+                closestEdgeProj = proj;
+            }
+            if (proj < 0)
+                continue;
+            f32 edgeProj  = Dot(V2(-n[i].y, n[i].x), o - t[i]);
+            f32 edgeProj2 = Dot(V2(-n[i].y, n[i].x), o - t[(i + 1) % 3]);
+            if (edgeProj < 0 || edgeProj2 > 0){
+                insideTriangle = false;
+            }else{
+                // Over the edge.
+                *outT = 0;
+                *outNormal = n[i];
+                *outContact = V2(p0) + (o - n[i]*proj);
+                return true;
+            }
+        }
+        if (!insideTriangle){
+            // Touching a vertex.
+            s32 closestVertex = 0;
+            for(s32 j = 1; j < 3; j++){
+                if (LengthSqr(t[j]) < LengthSqr(t[closestVertex]))
+                    closestVertex = j;
+            }
+            f32 distance = Length(t[closestVertex]);
+            *outT = 0;
+            *outNormal = (distance > 0 ? (o - t[closestVertex])/distance : n[closestEdge]);
+            *outContact = V2(p0) + t[closestVertex];
+            return true;
+        }
+        // Inside the triangle: push out through the closest edge.
+        *outT = 0;
+        *outNormal = n[closestEdge];
+        *outContact = V2(p0) + (o - n[closestEdge]*closestEdgeProj);
+        return true;
+    }
+
+    f32 bestT = FLT_MAX;
+    v2 bestNormal = {};
+    v2 bestContact = {};
+
+    // Outer side of each edge*radius rectangle.
+    for(s32 i = 0; i < 3; i++){
+        f32 approachSpeed = Dot(n[i], d);
+        if (approachSpeed >= 0) // Not moving towards this edge.
+            continue;
+        f32 proj = Dot(n[i], o - t[i]);
+        if (proj < r) // Already past that side.
+            continue;
+
+        f32 hitT = (r - proj)/approachSpeed;
+        if (hitT > 1 || hitT >= bestT)
+            continue;
+
+        v2 center = d*hitT;
+        f32 edgeProj  = Dot(V2(-n[i].y, n[i].x), center - t[i]);
+        f32 edgeProj2 = Dot(V2(-n[i].y, n[i].x), center - t[(i + 1) % 3]);
+        if (edgeProj < 0 || edgeProj2 > 0) // Passes beside the rectangle.
+            continue;
+
+        bestT = hitT;
+        bestNormal = n[i];
+        bestContact = center - n[i]*r;
+    }
+
+    // Vertex circles: |d*time - t[j]|^2 = r^2  ->  a*time^2 - 2*b*time + c = 0
+    f32 a = LengthSqr(d);
+    if (a > 0){
+        for(s32 j = 0; j < 3; j++){
+            f32 b = Dot(d, t[j]);
+            f32 c = LengthSqr(t[j]) - r*r;
+            f32 discriminant = b*b - a*c;
+            if (discriminant < 0)
+                continue;
+            f32 hitT = (b - Sqrt(discriminant))/a;
+            if (hitT < 0 || hitT > 1 || hitT >= bestT)
+                continue;
+
+            v2 fromVertex = d*hitT - t[j];
+            f32 distance = Length(fromVertex);
+            bestT = hitT;
+            bestNormal = (distance > 0 ? fromVertex/distance : -d/Sqrt(a));
+            bestContact = t[j];
+        }
+    }
+
+    if (bestT == FLT_MAX)
+        return false;
+
+    *outT = bestT;
+    *outNormal = bestNormal;
+    *outContact = V2(p0) + bestContact;
+    return true;
+}
+
+
+
+//
+// 8 walls at a time (AVX2)
+//
+// Walls stored as SoA so that CircleWallCollision8() can test a circle against 8 of them with the
+// same math as CircleWallCollision(): the loops and early outs become masks.
+// It gives exactly the same results as long as the compiler doesn't contract the scalar version
+// into FMAs (it doesn't with /fp:precise or -ffp-contract=off).
+// Without AVX2, CircleWallCollision8() calls CircleWallCollision() for each of the 8 walls.
+//
+
+struct wall_soa{
+    s32 numWalls;
+    s32 numWallsPadded; // Multiple of 8.
+    s32 *x[3];          // Vertices
+    s32 *y[3];
+    f32 *normalX[3];    // Edge normals
+    f32 *normalY[3];
+    void *mem;
+};
+
+void WallSoa_Build(wall_soa *soa, wall *walls, s32 numWalls){
+    ZeroStruct(soa);
+    soa->numWalls = numWalls;
+    soa->numWallsPadded = (numWalls + 7) & ~7;
+
+    umm arraySize = (umm)soa->numWallsPadded*sizeof(s32);
+    soa->mem = malloc(arraySize*12);
+    ZeroSize(soa->mem, arraySize*12);
+    u8 *scan = (u8 *)soa->mem;
+    for(s32 j = 0; j < 3; j++){
+        soa->x[j]       = (s32 *)scan; scan += arraySize;
+        soa->y[j]       = (s32 *)scan; scan += arraySize;
+        soa->normalX[j] = (f32 *)scan; scan += arraySize;
+        soa->normalY[j] = (f32 *)scan; scan += arraySize;
+    }
+
+    for(s32 i = 0; i < numWalls; i++){
+        for(s32 j = 0; j < 3; j++){
+            soa->x[j][i] = walls[i].p[j].x;
+            soa->y[j][i] = walls[i].p[j].y;
+            soa->normalX[j][i] = walls[i].normals[j].x;
+            soa->normalY[j][i] = walls[i].normals[j].y;
+        }
+    }
+}
+
+void WallSoa_Destruct(wall_soa *soa){
+    free(soa->mem);
+    ZeroStruct(soa);
+}
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+// - Tests the circle against walls 'first' to 'first' + 7.
+// - Returns a mask with bit i set if wall 'first' + i collides. Walls past the end are never set.
+u32 CircleWallCollision8(wall_soa *walls, s32 first, v2s center, s32 radius){
+    Assert(first >= 0 && first + 8 <= walls->numWallsPadded);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 r = _mm256_set1_ps((f32)radius);
+
+    // 'o - t' of the scalar version: center relative to each vertex.
+    __m256 ox[3], oy[3];
+    for(s32 j = 0; j < 3; j++){
+        __m256i tx = _mm256_sub_epi32(_mm256_loadu_si256((__m256i *)(walls->x[j] + first)), _mm256_set1_epi32(center.x));
+        __m256i ty = _mm256_sub_epi32(_mm256_loadu_si256((__m256i *)(walls->y[j] + first)), _mm256_set1_epi32(center.y));
+        ox[j] = _mm256_sub_ps(zero, _mm256_cvtepi32_ps(tx));
+        oy[j] = _mm256_sub_ps(zero, _mm256_cvtepi32_ps(ty));
+    }
+
+    __m256 decided  = zero; // Lanes where the scalar loop would have returned.
+    __m256 result   = zero;
+    __m256 outside  = zero; // Lanes where the scalar 'collision' became false.
+    for(s32 i = 0; i < 3; i++){
+        s32 next = (i + 1) % 3;
+        __m256 nx = _mm256_loadu_ps(walls->normalX[i] + first);
+        __m256 ny = _mm256_loadu_ps(walls->normalY[i] + first);
+
+        __m256 proj = _mm256_add_ps(_mm256_mul_ps(nx, ox[i]), _mm256_mul_ps(ny, oy[i]));
+        __m256 tooFar = _mm256_cmp_ps(proj, r, _CMP_GT_OQ);
+        __m256 inward = _mm256_cmp_ps(proj, zero, _CMP_LT_OQ);
+
+        __m256 ex = _mm256_sub_ps(zero, ny);
+        __m256 edgeProj  = _mm256_add_ps(_mm256_mul_ps(ex, ox[i]),    _mm256_mul_ps(nx, oy[i]));
+        __m256 edgeProj2 = _mm256_add_ps(_mm256_mul_ps(ex, ox[next]), _mm256_mul_ps(nx, oy[next]));
+        __m256 outsideRect = _mm256_or_ps(_mm256_cmp_ps(edgeProj, zero, _CMP_LT_OQ),
+                                          _mm256_cmp_ps(edgeProj2, zero, _CMP_GT_OQ));
+        // (The scalar version checks tooFar first, so it wins over the rect.)
+        __m256 inRect = _mm256_andnot_ps(tooFar, _mm256_andnot_ps(inward, _mm256_andnot_ps(outsideRect, _mm256_castsi256_ps(_mm256_set1_epi32(-1)))));
+
+        result  = _mm256_or_ps(result, _mm256_andnot_ps(decided, inRect));
+        outside = _mm256_or_ps(outside, _mm256_andnot_ps(inward, outsideRect));
+        decided = _mm256_or_ps(decided, _mm256_or_ps(tooFar, inRect));
+    }
+
+    // Lanes that went through the whole loop: inside the triangle, or check the vertex circles.
+    __m256 rSqr = _mm256_mul_ps(r, r);
+    __m256 vertexHit = zero;
+    for(s32 j = 0; j < 3; j++){
+        __m256 distanceSqr = _mm256_add_ps(_mm256_mul_ps(ox[j], ox[j]), _mm256_mul_ps(oy[j], oy[j]));
+        vertexHit = _mm256_or_ps(vertexHit, _mm256_cmp_ps(distanceSqr, rSqr, _CMP_LT_OQ));
+    }
+    __m256 undecidedResult = _mm256_or_ps(_mm256_andnot_ps(outside, _mm256_castsi256_ps(_mm256_set1_epi32(-1))),
+                                          vertexHit);
+    result = _mm256_or_ps(result, _mm256_andnot_ps(decided, undecidedResult));
+
+    u32 mask = (u32)_mm256_movemask_ps(result);
+    s32 numValid = walls->numWalls - first;
+    if (numValid < 8)
+        mask &= (1u << MaxS32(numValid, 0)) - 1;
+    return mask;
+}
+
+#else
+
+// - Same as the AVX2 version.
+u32 CircleWallCollision8(wall_soa *walls, s32 first, v2s center, s32 radius){
+    Assert(first >= 0 && first + 8 <= walls->numWallsPadded);
+    u32 mask = 0;
+    s32 end = MinS32(first + 8, walls->numWalls);
+    for(s32 i = first; i < end; i++){
+        wall w;
+        ZeroStruct(&w);
+        for(s32 j = 0; j < 3; j++){
+            v2s p = {walls->x[j][i], walls->y[j][i]};
+            w.p[j] = p;
+            w.normals[j] = V2(walls->normalX[j][i], walls->normalY[j][i]);
+        }
+        if (CircleWallCollision(&w, center, radius))
+            mask |= 1u << (i - first);
+    }
+    return mask;
+}
+
+#endif
+
+// - Writes to 'outWallIndices' the indices of the walls that collide with the circle (up to 'maxWalls').
+// - Returns the number of indices written.
+s32 CircleWallSoaCollisions(wall_soa *walls, v2s center, s32 radius, s32 *outWallIndices, s32 maxWalls){
+    TIMED_FUNCTION();
+    s32 count = 0;
+    for(s32 first = 0; first < walls->numWalls; first += 8){
+        u32 mask = CircleWallCollision8(walls, first, center, radius);
+        while(mask){
+            s32 bit = CountTrailingZeros(mask);
+            mask &= mask - 1;
+            if (count == maxWalls)
+                return count;
+            outWallIndices[count++] = first + bit;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,669 @@
+//
+// Checks for the collision queries (circle_wall_collision.cpp, wall_grid.cpp,
+// entity_moving_circle_collision.cpp, entity_moving_circle_batch.cpp): brute force references, and
+// randomized runs that compare the fast versions against them and time both.
+//
+// Has a lot of unincluded context.
+//
+
+/*
+ - The wall checks work on any walls. CollisionCheck_MakeWalls() makes random wall soups
+   (uniform or clustered) so they can be run without a level. CollisionCheck_WallSweeps() checks
+   CircleWallSweep() against stepping the circle along the path with CircleWallCollision().
+
+ - The entity checks run on synthetic entities: CollisionCheck_MakeEntities() fills an empty world
+   (any chunk size) with random entities, uniform or clustered, some of them outside of the chunk
+   that has them (by up to the query margin), and CollisionCheck_EntityWorlds() runs the queries
+   on a few densities of them. Call it with worlds of different chunk sizes.
+
+ - The references only use the exact per-shape tests (CircleWallCollision and
+   MovingCircleQuery_Test), and the entity one goes through the entities that the check made, with
+   the ChunkFlags_Active of their chunks (not w->activeChunks). So what they check is everything
+   on top of those: the broadphases, the active chunk grid, the chunk traversal, the entity index,
+   the 8-wide kernels, the batching and the hit ordering.
+
+ - Compile with COLLISION_QUERY_STATS 1 to also get chunks and entities visited per query.
+
+ - collision_check_main.cpp runs all of them without the game, with stubs for the world, the
+   entities, the walls and the vector math.
+*/
+
+struct collision_check_report{
+    s32 numQueries;
+    s32 mismatches;
+    s32 skippedQueries;   // More reference hits than fit in the buffer, so not compared (still timed).
+    u64 referenceCycles;
+    u64 cycles[3];        // Of each fast version (see the functions for which one is which).
+    s64 chunksVisited;    // Only with COLLISION_QUERY_STATS.
+    s64 entitiesVisited;
+};
+
+inline u32 CollisionCheck_Random(u32 *state){
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// - Range [min, max].
+inline s32 CollisionCheck_RandomRange(u32 *state, s32 min, s32 max){
+    Assert(min <= max);
+    s32 result = min + (s32)(CollisionCheck_Random(state) % ((u32)(max - min) + 1));
+    return result;
+}
+
+// - Counter-clockwise, with the outward normals that CircleWallCollision() expects.
+void CollisionCheck_MakeWall(wall *w, v2s a, v2s b, v2s c){
+    s64 cross = (s64)(b.x - a.x)*(c.y - a.y) - (s64)(b.y - a.y)*(c.x - a.x);
+    if (cross < 0){
+        v2s temp = b;
+        b = c;
+        c = temp;
+    }
+    w->p[0] = a;
+    w->p[1] = b;
+    w->p[2] = c;
+    for(s32 i = 0; i < 3; i++){
+        v2 edge = V2(w->p[(i + 1) % 3] - w->p[i]);
+        v2 normal = V2(edge.y, -edge.x);
+        w->normals[i] = normal/Length(normal);
+    }
+}
+
+// - Random point inside 'min' to 'max'. If 'numClusters' > 0, bunched around one of 'clusters'
+//   instead of uniform.
+v2s CollisionCheck_RandomPoint(u32 *rng, v2s min, v2s max, v2s *clusters, s32 numClusters, s32 clusterSpread){
+    v2s result;
+    if (numClusters > 0){
+        v2s center = clusters[CollisionCheck_RandomRange(rng, 0, numClusters - 1)];
+        // Sum of two, so they're denser near the center.
+        result.x = center.x + CollisionCheck_RandomRange(rng, -clusterSpread, clusterSpread) +
+                              CollisionCheck_RandomRange(rng, -clusterSpread, clusterSpread);
+        result.y = center.y + CollisionCheck_RandomRange(rng, -clusterSpread, clusterSpread) +
+                              CollisionCheck_RandomRange(rng, -clusterSpread, clusterSpread);
+        result.x = ClampS32(result.x, min.x, max.x);
+        result.y = ClampS32(result.y, min.y, max.y);
+    }else{
+        result.x = CollisionCheck_RandomRange(rng, min.x, max.x);
+        result.y = CollisionCheck_RandomRange(rng, min.y, max.y);
+    }
+    return result;
+}
+
+// - Up to 64 random cluster centers inside 'min' to 'max'. Returns how many.
+s32 CollisionCheck_MakeClusters(u32 *rng, v2s *clusters, s32 numClusters, v2s min, v2s max, s32 *outClusterSpread){
+    numClusters = MinS32(numClusters, 64);
+    for(s32 i = 0; i < numClusters; i++){
+        clusters[i].x = CollisionCheck_RandomRange(rng, min.x, max.x);
+        clusters[i].y = CollisionCheck_RandomRange(rng, min.y, max.y);
+    }
+    *outClusterSpread = MaxS32(MinS32(max.x - min.x, max.y - min.y)/16, 1);
+    return numClusters;
+}
+
+// - Random triangles of up to 'maxSize' inside 'min' to 'max'.
+// - If 'numClusters' > 0, they're bunched around that many random points instead of uniform.
+void CollisionCheck_MakeWalls(wall *walls, s32 numWalls, v2s min, v2s max, s32 maxSize,
+                              s32 numClusters, u32 seed){
+    Assert(maxSize > 0 && seed);
+    u32 rng = seed;
+    v2s clusters[64];
+    s32 clusterSpread;
+    numClusters = CollisionCheck_MakeClusters(&rng, clusters, numClusters, min, max, &clusterSpread);
+
+    for(s32 i = 0; i < numWalls; i++){
+        v2s a = CollisionCheck_RandomPoint(&rng, min, max, clusters, numClusters, clusterSpread);
+
+        v2s b, c;
+        s64 cross;
+        do{
+            b.x = a.x + CollisionCheck_RandomRange(&rng, -maxSize, maxSize);
+            b.y = a.y + CollisionCheck_RandomRange(&rng, -maxSize, maxSize);
+            c.x = a.x + CollisionCheck_RandomRange(&rng, -maxSize, maxSize);
+            c.y = a.y + CollisionCheck_RandomRange(&rng, -maxSize, maxSize);
+            cross = (s64)(b.x - a.x)*(c.y - a.y) - (s64)(b.y - a.y)*(c.x - a.x);
+        }while(cross == 0); // No degenerate walls.
+        CollisionCheck_MakeWall(&walls[i], a, b, c);
+    }
+}
+
+void CollisionCheck_SortIndices(s32 *indices, s32 count){
+    for(s32 i = 1; i < count; i++){
+        s32 index = indices[i];
+        s32 j = i;
+        for(; j > 0 && indices[j - 1] > index; j--){
+            indices[j] = indices[j - 1];
+        }
+        indices[j] = index;
+    }
+}
+
+// - __rdtsc() ticks per second, timed against clock() for a tenth of a second the first time.
+f64 CollisionCheck_CyclesPerSecond(){
+    local_persist f64 cyclesPerSecond = 0;
+    if (!cyclesPerSecond){
+        clock_t start = clock();
+        while(clock() == start){} // Start on a tick edge.
+        start = clock();
+        u64 startCycles = __rdtsc();
+        clock_t end;
+        do{
+            end = clock();
+        }while(end - start < CLOCKS_PER_SEC/10);
+        cyclesPerSecond = (f64)(__rdtsc() - startCycles)*(f64)CLOCKS_PER_SEC/(f64)(end - start);
+    }
+    return cyclesPerSecond;
+}
+
+// - Throughput in queries per second (from the cycles and CollisionCheck_CyclesPerSecond()), of the
+//   reference and of each fast version that was timed.
+void CollisionCheck_Print(char *name, collision_check_report *report){
+    f64 numQueries = (f64)MaxS32(report->numQueries, 1);
+    f64 cyclesPerSecond = CollisionCheck_CyclesPerSecond();
+    printf("%s: %d queries, %d mismatches, %d skipped\n", name, report->numQueries,
+           report->mismatches, report->skippedQueries);
+    f64 referenceQueriesPerSecond = (report->referenceCycles ? numQueries*cyclesPerSecond/(f64)report->referenceCycles : 0);
+    printf("    queries/sec: reference %.0f, fast", referenceQueriesPerSecond);
+    for(s32 i = 0; i < ArrayCount(report->cycles); i++){
+        if (report->cycles[i])
+            printf("%s %.0f", (i ? " /" : ""), numQueries*cyclesPerSecond/(f64)report->cycles[i]);
+    }
+    printf("\n");
+    if (report->chunksVisited){
+        printf("    chunks/query %.2f, entities/query %.2f\n",
+               (f64)report->chunksVisited/numQueries, (f64)report->entitiesVisited/numQueries);
+    }
+}
+
+
+
+//
+// Walls
+//
+
+// - Indices of all the walls that collide with the circle, ascending.
+// - Returns how many collide, which can be more than 'maxWalls' (only 'maxWalls' are written).
+s32 CircleWallCollisions_Reference(wall *walls, s32 numWalls, v2s center, s32 radius,
+                                   s32 *outWallIndices, s32 maxWalls){
+    s32 count = 0;
+    for(s32 i = 0; i < numWalls; i++){
+        if (CircleWallCollision(&walls[i], center, radius)){
+            if (count < maxWalls)
+                outWallIndices[count] = i;
+            count++;
+        }
+    }
+    return count;
+}
+
+// - Compares against CircleWallCollisions_Reference(): cycles[0] is WallGrid_CircleWallCollisions,
+//   cycles[1] is CircleWallSoaCollisions.
+// - Query centers are random points of the walls' bounds grown by 'maxRadius'.
+void CollisionCheck_Walls(collision_check_report *report, wall *walls, s32 numWalls, s32 cellSize,
+                          s32 numQueries, s32 maxRadius, u32 seed){
+    Assert(numWalls > 0 && maxRadius > 0 && seed);
+    ZeroStruct(report);
+    u32 rng = seed;
+
+    wall_grid grid;
+    WallGrid_Build(&grid, walls, numWalls, cellSize);
+    wall_soa soa;
+    WallSoa_Build(&soa, walls, numWalls);
+
+    v2s min = V2S(S32_MAX);
+    v2s max = V2S(S32_MIN);
+    for(s32 i = 0; i < numWalls; i++){
+        for(s32 j = 0; j < 3; j++){
+            min = MinV2S(min, walls[i].p[j]);
+            max = MaxV2S(max, walls[i].p[j]);
+        }
+    }
+    min = min - V2S(maxRadius);
+    max = max + V2S(maxRadius);
+
+    s32 maxHits = 1024;
+    s32 *reference = (s32 *)malloc(sizeof(s32)*maxHits*3);
+    s32 *gridHits = reference + maxHits;
+    s32 *soaHits = gridHits + maxHits;
+    wall **gridWalls = (wall **)malloc(sizeof(wall *)*maxHits);
+
+    for(s32 query = 0; query < numQueries; query++){
+        v2s center = {CollisionCheck_RandomRange(&rng, min.x, max.x), CollisionCheck_RandomRange(&rng, min.y, max.y)};
+        s32 radius = CollisionCheck_RandomRange(&rng, 1, maxRadius);
+        report->numQueries++;
+
+        u64 start = __rdtsc();
+        s32 numReference = CircleWallCollisions_Reference(walls, numWalls, center, radius, reference, maxHits);
+        report->referenceCycles += __rdtsc() - start;
+
+        start = __rdtsc();
+        s32 numGrid = WallGrid_CircleWallCollisions(&grid, center, radius, gridWalls, maxHits);
+        report->cycles[0] += __rdtsc() - start;
+
+        start = __rdtsc();
+        s32 numSoa = CircleWallSoaCollisions(&soa, center, radius, soaHits, maxHits);
+        report->cycles[1] += __rdtsc() - start;
+
+        if (numReference >= maxHits){
+            report->skippedQueries++;
+            continue;
+        }
+
+        // The grid finds them in cell order.
+        for(s32 i = 0; i < numGrid; i++)
+            gridHits[i] = (s32)(gridWalls[i] - walls);
+        CollisionCheck_SortIndices(gridHits, numGrid);
+
+        b32 ok = (numGrid == numReference && numSoa == numReference);
+        for(s32 i = 0; ok && i < numReference; i++)
+            ok = (gridHits[i] == reference[i] && soaHits[i] == reference[i]);
+        if (!ok)
+            report->mismatches++;
+    }
+
+    free(reference);
+    free(gridWalls);
+    WallSoa_Destruct(&soa);
+    WallGrid_Destruct(&grid);
+}
+
+// - Steps the circle from 'p0' to 'p1' at most half a unit at a time and returns the first step
+//   where CircleWallCollision() is true, or -1. There are '*outNumSteps' steps after 'p0'.
+s32 CircleWallSweep_Reference(wall *w, v2s p0, v2s p1, s32 radius, s32 *outNumSteps){
+    v2 d = V2(p1 - p0);
+    s32 numSteps = MaxS32((s32)ceilf(2.f*Length(d)), 1);
+    *outNumSteps = numSteps;
+    for(s32 step = 0; step <= numSteps; step++){
+        v2 offset = d*((f32)step/(f32)numSteps);
+        v2s center = {p0.x + (s32)floorf(offset.x + .5f), p0.y + (s32)floorf(offset.y + .5f)};
+        if (CircleWallCollision(w, center, radius))
+            return step;
+    }
+    return -1;
+}
+
+// - Compares CircleWallSweep() against CircleWallSweep_Reference(): cycles[0] is CircleWallSweep.
+// - The reference circles are on integer centers, up to 0.71 away from the real path, so it's
+//   stepped with 'radius' - 1 (the sweep has to hit no later than that) and 'radius' + 1 (the
+//   sweep can't hit before that, minus one step).
+// - Also checks that the normal is unit length and that, when it didn't start colliding, the
+//   contact is 'radius' away from the center at the time of impact.
+// - Each query sweeps against one random wall, from a random point near it, half of them aimed at
+//   its middle.
+void CollisionCheck_WallSweeps(collision_check_report *report, wall *walls, s32 numWalls,
+                               s32 numQueries, s32 maxLength, s32 maxRadius, u32 seed){
+    Assert(numWalls > 0 && maxLength > 0 && maxRadius > 1 && seed);
+    ZeroStruct(report);
+    u32 rng = seed;
+
+    for(s32 query = 0; query < numQueries; query++){
+        wall *w = &walls[CollisionCheck_RandomRange(&rng, 0, numWalls - 1)];
+        v2s min = MinV2S(MinV2S(w->p[0], w->p[1]), w->p[2]) - V2S(maxLength + maxRadius);
+        v2s max = MaxV2S(MaxV2S(w->p[0], w->p[1]), w->p[2]) + V2S(maxLength + maxRadius);
+        v2s p0 = {CollisionCheck_RandomRange(&rng, min.x, max.x), CollisionCheck_RandomRange(&rng, min.y, max.y)};
+        v2s p1;
+        if (query % 2){
+            v2s middle = (w->p[0] + w->p[1] + w->p[2])/3;
+            p1.x = middle.x + CollisionCheck_RandomRange(&rng, -maxRadius, maxRadius);
+            p1.y = middle.y + CollisionCheck_RandomRange(&rng, -maxRadius, maxRadius);
+        }else{
+            p1.x = p0.x + CollisionCheck_RandomRange(&rng, -maxLength, maxLength);
+            p1.y = p0.y + CollisionCheck_RandomRange(&rng, -maxLength, maxLength);
+        }
+        if (query % 32 == 0)
+            p1 = p0; // Not moving
+        s32 radius = CollisionCheck_RandomRange(&rng, 2, maxRadius);
+        report->numQueries++;
+
+        u64 start = __rdtsc();
+        s32 numSteps;
+        s32 innerStep = CircleWallSweep_Reference(w, p0, p1, radius - 1, &numSteps);
+        s32 outerStep = CircleWallSweep_Reference(w, p0, p1, radius + 1, &numSteps);
+        report->referenceCycles += __rdtsc() - start;
+
+        f32 t = 0;
+        v2 contact = {};
+        v2 normal = {};
+        start = __rdtsc();
+        b32 hit = CircleWallSweep(w, p0, p1, radius, &t, &contact, &normal);
+        report->cycles[0] += __rdtsc() - start;
+
+        b32 ok;
+        if (hit){
+            f32 step = 1.f/(f32)numSteps;
+            ok = (t >= 0 && t <= 1 && outerStep >= 0 && (f32)outerStep*step <= t + step + 1e-5f);
+            if (innerStep >= 0)
+                ok = ok && (t <= (f32)innerStep*step + 1e-5f);
+            ok = ok && fabsf(Length(normal) - 1.f) < 1e-3f;
+            if (t > 0){
+                v2 center = V2(p0) + V2(p1 - p0)*t;
+                ok = ok && fabsf(Length(contact - center) - (f32)radius) < 0.1f;
+            }
+        }else{
+            ok = (innerStep < 0);
+        }
+        if (!ok)
+            report->mismatches++;
+    }
+}
+
+
+
+//
+// Entities
+//
+
+#define COLLISION_CHECK_ENTITIES_PER_BLOCK 64
+
+// - Entities that CollisionCheck_MakeEntities() added to a world.
+struct collision_check_entities{
+    world *w;
+    v2s chunkMin; // Inclusive chunk positions of the region they're in.
+    v2s chunkMax;
+    s32 numEntities;
+    entity **entities;
+    chunk **entityChunks;  // The chunk that has each one (not always the one of its position).
+    u32 *chunkFlags;       // Of each chunk of the region (row by row) before they were added.
+    s32 numBlocks;
+    entity_block **blocks; // The check allocated them, so it frees them.
+};
+
+// - 'w' has to be an empty world (no entities) where every chunk from 'chunkMin' to 'chunkMax'
+//   exists. Its chunk size can be anything.
+// - Adds 'numEntities' entities of random types and positions inside those chunks, uniform, or
+//   bunched around 'numClusters' random points if it's > 0. 1 in 16 is flagged
+//   EntityFlags_RemoveAtEndOfFrame. Eids go from 1 to 'numEntities'.
+// - If 'maxOutside' > 0, half of them are then moved up to that many units away in x and y, but
+//   stay in the chunk they were in, like entities that moved and haven't changed chunks yet. It
+//   can't be more than MOVING_CIRCLE_QUERY_CHUNK_MARGIN.
+// - Every chunk of the region is made active, except 1 in 'inactiveChunkEvery' (if > 0), and then
+//   w->activeChunks is updated for the region. CollisionCheck_RemoveEntities() puts the flags back.
+// - The entities go in blocks of COLLISION_CHECK_ENTITIES_PER_BLOCK that the check allocates, and
+//   into the chunk_entity_index with ChunkEntityIndex_Add(). Nothing else can add or remove
+//   entities in the region until CollisionCheck_RemoveEntities().
+void CollisionCheck_MakeEntities(collision_check_entities *entities, world *w, v2s chunkMin, v2s chunkMax,
+                                 s32 numEntities, s32 numClusters, s32 maxOutside, s32 inactiveChunkEvery,
+                                 u32 seed){
+    Assert(chunkMin.x <= chunkMax.x && chunkMin.y <= chunkMax.y && numEntities >= 0 && seed);
+    Assert(maxOutside <= MOVING_CIRCLE_QUERY_CHUNK_MARGIN);
+    ZeroStruct(entities);
+    entities->w = w;
+    entities->chunkMin = chunkMin;
+    entities->chunkMax = chunkMax;
+    u32 rng = seed;
+
+    s32 numChunks = (chunkMax.x - chunkMin.x + 1)*(chunkMax.y - chunkMin.y + 1);
+    entities->chunkFlags = (u32 *)malloc(sizeof(u32)*numChunks);
+    u32 *savedFlags = entities->chunkFlags;
+    for(s32 cy = chunkMin.y; cy <= chunkMax.y; cy++){
+        for(s32 cx = chunkMin.x; cx <= chunkMax.x; cx++){
+            v2s chunkPos = {cx, cy};
+            chunk *c = GetChunk(w, chunkPos);
+            Assert(c && !c->hotEntities);
+            *savedFlags++ = c->flags;
+            if (inactiveChunkEvery > 0 && CollisionCheck_RandomRange(&rng, 1, inactiveChunkEvery) == 1)
+                c->flags &= ~ChunkFlags_Active;
+            else
+                c->flags |= ChunkFlags_Active;
+        }
+    }
+
+    v2s min = ChunkToWorldPos(w, chunkMin);
+    v2s max = ChunkToWorldPos(w, chunkMax + V2S(1)) - V2S(1);
+    v2s clusters[64];
+    s32 clusterSpread;
+    numClusters = CollisionCheck_MakeClusters(&rng, clusters, numClusters, min, max, &clusterSpread);
+
+    s32 maxBlocks = numEntities/COLLISION_CHECK_ENTITIES_PER_BLOCK + numChunks;
+    entities->entities = (entity **)malloc(sizeof(entity *)*MaxS32(numEntities, 1));
+    entities->entityChunks = (chunk **)malloc(sizeof(chunk *)*MaxS32(numEntities, 1));
+    entities->blocks = (entity_block **)malloc(sizeof(entity_block *)*maxBlocks);
+    for(s32 i = 0; i < numEntities; i++){
+        v2s pos = CollisionCheck_RandomPoint(&rng, min, max, clusters, numClusters, clusterSpread);
+        chunk *c = GetChunk(w, WorldPosToChunk(w, pos));
+
+        entity_block *block = c->hotEntities;
+        if (!block || block->numEntitiesInBlock == COLLISION_CHECK_ENTITIES_PER_BLOCK){
+            Assert(entities->numBlocks < maxBlocks);
+            block = (entity_block *)malloc(sizeof(entity_block) + sizeof(entity)*COLLISION_CHECK_ENTITIES_PER_BLOCK);
+            ZeroStruct(block);
+            block->nextBlock = c->hotEntities;
+            c->hotEntities = block;
+            entities->blocks[entities->numBlocks++] = block;
+        }
+        entity *e = (entity *)(block + 1) + block->numEntitiesInBlock++;
+        ZeroStruct(e);
+        e->eid = (u64)(i + 1);
+        e->type = (entity_type)CollisionCheck_RandomRange(&rng, 0, EntityType_Count - 1);
+        if (CollisionCheck_RandomRange(&rng, 0, 15) == 0)
+            e->flags |= EntityFlags_RemoveAtEndOfFrame;
+        e->pos = pos;
+        if (maxOutside > 0 && CollisionCheck_RandomRange(&rng, 0, 1)){
+            v2s offset = {CollisionCheck_RandomRange(&rng, -maxOutside, maxOutside),
+                          CollisionCheck_RandomRange(&rng, -maxOutside, maxOutside)};
+            e->pos = ClampWorldPos(w, pos + offset);
+        }
+        ChunkEntityIndex_Add(c, e);
+        entities->entities[entities->numEntities] = e;
+        entities->entityChunks[entities->numEntities] = c;
+        entities->numEntities++;
+    }
+
+    ActiveChunkGrid_Update(&w->activeChunks, w, chunkMin, chunkMax);
+}
+
+// - Takes the entities out of the chunks and their indices, and frees them. Puts back the chunk
+//   flags and updates w->activeChunks for the region, so the world is like before
+//   CollisionCheck_MakeEntities().
+void CollisionCheck_RemoveEntities(collision_check_entities *entities){
+    world *w = entities->w;
+    for(s32 i = 0; i < entities->numEntities; i++){
+        ChunkEntityIndex_Remove(entities->entityChunks[i], entities->entities[i]);
+    }
+    u32 *savedFlags = entities->chunkFlags;
+    for(s32 cy = entities->chunkMin.y; cy <= entities->chunkMax.y; cy++){
+        for(s32 cx = entities->chunkMin.x; cx <= entities->chunkMax.x; cx++){
+            v2s chunkPos = {cx, cy};
+            chunk *c = GetChunk(w, chunkPos);
+            c->hotEntities = 0;
+            c->flags = *savedFlags++;
+        }
+    }
+    ActiveChunkGrid_Update(&w->activeChunks, w, entities->chunkMin, entities->chunkMax);
+    for(s32 i = 0; i < entities->numBlocks; i++){
+        free(entities->blocks[i]);
+    }
+    free(entities->entities);
+    free(entities->entityChunks);
+    free(entities->chunkFlags);
+    free(entities->blocks);
+    ZeroStruct(entities);
+}
+
+// - Every entity of the type that collides with the moving circle, sorted with EntityHitIsBefore().
+// - Goes through all of 'entities' (reading the entities themselves, not the chunk_entity_index)
+//   and checks the flags of the chunk that has each one, so it doesn't depend on w->activeChunks
+//   being up to date, or on entities being inside of their chunk.
+// - Returns how many collide, which can be more than 'maxHits' (then the hits are not sorted).
+s32 EntityMovingCircleCollisionAll_Reference(collision_check_entities *entities, entity_type entityType,
+                                             s32 r, v2s p1, v2s p0, entity_hit *outHits, s32 maxHits,
+                                             u64 eidException = 0){
+    world *w = entities->w;
+    moving_circle_query q = MovingCircleQuery(w, r, p1, p0);
+    s32 count = 0;
+    for(s32 i = 0; i < entities->numEntities; i++){
+        entity *e = entities->entities[i];
+        if (e->type != entityType || (e->flags & EntityFlags_RemoveAtEndOfFrame))
+            continue;
+        if (e->eid == eidException)
+            continue;
+        if (!MovingCircleQuery_Test(&q, e->pos))
+            continue;
+        if (!(entities->entityChunks[i]->flags & ChunkFlags_Active))
+            continue;
+
+        if (count < maxHits){
+            outHits[count].e = e;
+            outHits[count].t = MovingCircleQuery_TimeOfHit(&q, e->pos);
+        }
+        count++;
+    }
+    if (count <= maxHits)
+        SortEntityHits(outHits, count);
+    return count;
+}
+
+// - Compares against EntityMovingCircleCollisionAll_Reference(): cycles[0] is
+//   EntityMovingCircleCollisionAll, cycles[1] is EntityMovingCircleCollisionNearest, and cycles[2]
+//   is all the queries in one MovingCircleBatch (single thread). EntityMovingCircleCollision is
+//   checked too, but not timed.
+// - Queries start at random points of the entities' region.
+// - Every 8th query excludes the entity that the reference hits first, to check 'eidException'.
+void CollisionCheck_EntityQueries(collision_check_report *report, collision_check_entities *entities,
+                                  s32 numQueries, s32 maxLength, s32 maxRadius, u32 seed){
+    Assert(maxRadius > 0 && seed);
+    ZeroStruct(report);
+    u32 rng = seed;
+    world *w = entities->w;
+    v2s regionMin = ChunkToWorldPos(w, entities->chunkMin);
+    v2s regionMax = ChunkToWorldPos(w, entities->chunkMax + V2S(1)) - V2S(1);
+
+    s32 maxHits = 4096;
+    entity_hit *reference = (entity_hit *)malloc(sizeof(entity_hit)*maxHits*2);
+    entity_hit *hits = reference + maxHits;
+    moving_circle_batch_query *batchQueries = (moving_circle_batch_query *)malloc(sizeof(moving_circle_batch_query)*MaxS32(numQueries, 1));
+    entity_hit *batchResults = (entity_hit *)malloc(sizeof(entity_hit)*MaxS32(numQueries, 1));
+    entity_hit *nearestReference = (entity_hit *)malloc(sizeof(entity_hit)*MaxS32(numQueries, 1));
+    b32 *skipped = (b32 *)malloc(sizeof(b32)*MaxS32(numQueries, 1));
+
+    for(s32 query = 0; query < numQueries; query++){
+        moving_circle_batch_query *bq = &batchQueries[query];
+        bq->p0.x = CollisionCheck_RandomRange(&rng, regionMin.x, regionMax.x);
+        bq->p0.y = CollisionCheck_RandomRange(&rng, regionMin.y, regionMax.y);
+        bq->p1.x = bq->p0.x + CollisionCheck_RandomRange(&rng, -maxLength, maxLength);
+        bq->p1.y = bq->p0.y + CollisionCheck_RandomRange(&rng, -maxLength, maxLength);
+        if (query % 32 == 0)
+            bq->p1 = bq->p0; // Not moving
+        bq->r = CollisionCheck_RandomRange(&rng, 1, maxRadius);
+        bq->entityType = (entity_type)CollisionCheck_RandomRange(&rng, 0, EntityType_Count - 1);
+        bq->eidException = 0;
+        report->numQueries++;
+
+        u64 start = __rdtsc();
+        s32 numReference = EntityMovingCircleCollisionAll_Reference(entities, bq->entityType, bq->r, bq->p1, bq->p0,
+                                                                    reference, maxHits);
+        if (query % 8 == 1 && numReference > 0 && numReference <= maxHits){
+            bq->eidException = reference[0].e->eid;
+            numReference = EntityMovingCircleCollisionAll_Reference(entities, bq->entityType, bq->r, bq->p1, bq->p0,
+                                                                    reference, maxHits, bq->eidException);
+        }
+        report->referenceCycles += __rdtsc() - start;
+
+#if COLLISION_QUERY_STATS
+        collision_query_stats statsStart = collisionQueryStats;
+#endif
+        start = __rdtsc();
+        s32 numHits = EntityMovingCircleCollisionAll(w, bq->entityType, bq->r, bq->p1, bq->p0,
+                                                     hits, maxHits, true, bq->eidException);
+        report->cycles[0] += __rdtsc() - start;
+#if COLLISION_QUERY_STATS
+        report->chunksVisited   += collisionQueryStats.chunksVisited   - statsStart.chunksVisited;
+        report->entitiesVisited += collisionQueryStats.entitiesVisited - statsStart.entitiesVisited;
+#endif
+
+        f32 nearestT = 0;
+        start = __rdtsc();
+        entity *nearest = EntityMovingCircleCollisionNearest(w, bq->entityType, bq->r, bq->p1, bq->p0,
+                                                             bq->eidException, &nearestT);
+        report->cycles[1] += __rdtsc() - start;
+
+        entity *any = EntityMovingCircleCollision(w, bq->entityType, bq->r, bq->p1, bq->p0, bq->eidException);
+
+        nearestReference[query].e = 0;
+        skipped[query] = (numReference > maxHits);
+        if (skipped[query]){
+            report->skippedQueries++;
+            continue;
+        }
+        if (numReference)
+            nearestReference[query] = reference[0];
+
+        b32 ok = (numHits == numReference);
+        for(s32 i = 0; ok && i < numReference; i++)
+            ok = (hits[i].e == reference[i].e && hits[i].t == reference[i].t);
+        if (numReference)
+            ok = ok && (nearest == reference[0].e && nearestT == reference[0].t);
+        else
+            ok = ok && !nearest;
+        ok = ok && ((any != 0) == (numReference > 0));
+        if (!ok)
+            report->mismatches++;
+    }
+
+    u64 start = __rdtsc();
+    moving_circle_batch batch;
+    MovingCircleBatch_Begin(&batch, w, batchQueries, numQueries, batchResults);
+    MovingCircleBatch_Work(&batch);
+    MovingCircleBatch_End(&batch);
+    report->cycles[2] += __rdtsc() - start;
+    for(s32 query = 0; query < numQueries; query++){
+        if (skipped[query])
+            continue;
+        entity_hit *expected = &nearestReference[query];
+        entity_hit *result = &batchResults[query];
+        // No reference hit means the batch can't have one either.
+        if (result->e != expected->e || (expected->e && result->t != expected->t))
+            report->mismatches++;
+    }
+
+    free(reference);
+    free(batchQueries);
+    free(batchResults);
+    free(nearestReference);
+    free(skipped);
+}
+
+// - Runs CollisionCheck_EntityQueries() on entities made with CollisionCheck_MakeEntities() in
+//   'w', with a few densities, uniform and clustered, and prints the reports. Queries are up to 4
+//   chunks long and half a chunk of radius.
+// - Same requirements for 'w' as CollisionCheck_MakeEntities(). It's left empty again.
+// - Returns the total number of mismatches.
+s32 CollisionCheck_EntityWorlds(world *w, v2s chunkMin, v2s chunkMax, s32 numQueries, u32 seed){
+    struct entity_world{
+        char *name;
+        s32 entitiesPerChunk;
+        s32 numClusters;
+        s32 maxOutside;
+    };
+    entity_world worlds[] = {
+        {"empty",                             0, 0, 0},
+        {"sparse uniform",                    1, 0, 0},
+        {"uniform",                          16, 0, 0},
+        {"dense uniform",                   128, 0, 0},
+        {"clustered",                        16, 8, 0},
+        {"dense clustered",                 128, 2, 0},
+        {"uniform, outside their chunks",    16, 0, MOVING_CIRCLE_QUERY_CHUNK_MARGIN},
+        {"clustered, outside their chunks", 128, 2, MOVING_CIRCLE_QUERY_CHUNK_MARGIN},
+    };
+
+    s32 chunkSize = ChunkToWorldPos(w, V2S(1)).x - ChunkToWorldPos(w, V2S(0)).x;
+    s32 numChunks = (chunkMax.x - chunkMin.x + 1)*(chunkMax.y - chunkMin.y + 1);
+    s32 mismatches = 0;
+    for(s32 i = 0; i < ArrayCount(worlds); i++){
+        collision_check_entities entities;
+        CollisionCheck_MakeEntities(&entities, w, chunkMin, chunkMax, worlds[i].entitiesPerChunk*numChunks,
+                                    worlds[i].numClusters, worlds[i].maxOutside, 16, seed + i);
+
+        collision_check_report report;
+        CollisionCheck_EntityQueries(&report, &entities, numQueries, 4*chunkSize, MaxS32(chunkSize/2, 1), seed + i);
+        char name[128];
+        snprintf(name, sizeof(name), "Entities, %s, chunk size %d", worlds[i].name, chunkSize);
+        CollisionCheck_Print(name, &report);
+        mismatches += report.mismatches;
+
+        CollisionCheck_RemoveEntities(&entities);
+    }
+    return mismatches;
+}
@@ -0,0 +1,287 @@
+//
+// Standalone build of the collision checks (collision_check.cpp). Stubs the bits of the game the
+// queries need (world, chunk, entity and entity_block, wall, and the v2/v2s math), so the checks
+// can be run without a level:
+//
+//     cl /O2 /arch:AVX2 /nologo collision_check_main.cpp
+//     g++ -O2 -mavx2 -Wno-write-strings collision_check_main.cpp -o collision_check
+//
+// Without AVX2 the queries use their scalar versions. Add -DCOLLISION_QUERY_STATS=1 to also get
+// chunks and entities visited per query. The exit code is the number of mismatches.
+//
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <limits.h>
+#include <time.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+
+//
+// Base (stub)
+//
+typedef int8_t   s8;
+typedef int16_t  s16;
+typedef int32_t  s32;
+typedef int64_t  s64;
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef float    f32;
+typedef double   f64;
+typedef s32      b32;
+typedef size_t   umm;
+
+#define S32_MIN INT_MIN
+#define S32_MAX INT_MAX
+
+#define local_persist   static
+#define global_variable static
+
+#define Assert(expr) do{ if (!(expr)){ fprintf(stderr, "%s(%d): Assert(%s)\n", __FILE__, __LINE__, #expr); abort(); } }while(0)
+#define InvalidCodepath Assert(!"InvalidCodepath")
+#define ArrayCount(a) ((s32)(sizeof(a)/sizeof((a)[0])))
+#define ZeroStruct(p) memset((p), 0, sizeof(*(p)))
+#define ZeroSize(p, size) memset((p), 0, (size))
+#define SQUARE(x) ((x)*(x))
+
+#define TIMED_FUNCTION()
+#define TIMED_BLOCK(name)
+
+#if !defined(_MSC_VER)
+inline long _InterlockedIncrement(volatile long *p){ return __sync_add_and_fetch(p, 1); }
+inline s64 _InterlockedExchangeAdd64(volatile s64 *p, s64 value){ return __sync_fetch_and_add(p, value); }
+#endif
+
+inline s32 MinS32(s32 a, s32 b){ return (a < b ? a : b); }
+inline s32 MaxS32(s32 a, s32 b){ return (a > b ? a : b); }
+inline s32 ClampS32(s32 a, s32 lo, s32 hi){ return (a < lo ? lo : (a > hi ? hi : a)); }
+inline f32 MinF32(f32 a, f32 b){ return (a < b ? a : b); }
+inline f32 MaxF32(f32 a, f32 b){ return (a > b ? a : b); }
+inline f32 Clamp(f32 a, f32 lo, f32 hi){ return (a < lo ? lo : (a > hi ? hi : a)); }
+inline f32 Abs(f32 a){ return fabsf(a); }
+inline f32 Floor(f32 a){ return floorf(a); }
+inline f32 Sqrt(f32 a){ return sqrtf(a); }
+inline s64 SquareS64(s64 a){ return a*a; }
+inline s32 CeilF32ToS32(f32 a){ return (s32)ceilf(a); }
+inline s32 SafeUmmToS32(umm a){ Assert(a <= (umm)S32_MAX); return (s32)a; }
+
+inline s32 CountTrailingZeros(u32 a){
+    Assert(a);
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, a);
+    return (s32)index;
+#else
+    return __builtin_ctz(a);
+#endif
+}
+
+
+//
+// Vectors (stub)
+//
+struct v2{ f32 x, y; };
+struct v2s{ s32 x, y; };
+
+inline v2 V2(f32 a){ v2 result = {a, a}; return result; }
+inline v2 V2(f32 x, f32 y){ v2 result = {x, y}; return result; }
+inline v2 V2(v2s a){ v2 result = {(f32)a.x, (f32)a.y}; return result; }
+inline v2s V2S(s32 a){ v2s result = {a, a}; return result; }
+
+inline v2 operator+(v2 a, v2 b){ return V2(a.x + b.x, a.y + b.y); }
+inline v2 operator-(v2 a, v2 b){ return V2(a.x - b.x, a.y - b.y); }
+inline v2 operator-(v2 a){ return V2(-a.x, -a.y); }
+inline v2 operator*(v2 a, f32 b){ return V2(a.x*b, a.y*b); }
+inline v2 operator*(f32 a, v2 b){ return b*a; }
+inline v2 operator/(v2 a, f32 b){ return V2(a.x/b, a.y/b); }
+inline f32 Dot(v2 a, v2 b){ return a.x*b.x + a.y*b.y; }
+inline f32 Cross(v2 a, v2 b){ return a.x*b.y - a.y*b.x; }
+inline f32 LengthSqr(v2 a){ return Dot(a, a); }
+inline f32 Length(v2 a){ return Sqrt(LengthSqr(a)); }
+inline v2 Rotate90Degrees(v2 a){ return V2(-a.y, a.x); }
+
+inline v2s operator+(v2s a, v2s b){ v2s result = {a.x + b.x, a.y + b.y}; return result; }
+inline v2s operator-(v2s a, v2s b){ v2s result = {a.x - b.x, a.y - b.y}; return result; }
+inline v2s operator/(v2s a, s32 b){ v2s result = {a.x/b, a.y/b}; return result; }
+inline bool operator==(v2s a, v2s b){ return a.x == b.x && a.y == b.y; }
+inline v2s MinV2S(v2s a, v2s b){ v2s result = {MinS32(a.x, b.x), MinS32(a.y, b.y)}; return result; }
+inline v2s MaxV2S(v2s a, v2s b){ v2s result = {MaxS32(a.x, b.x), MaxS32(a.y, b.y)}; return result; }
+
+
+//
+// World (stub). Only the members the queries touch.
+//
+// The game's chunk and world have the chunk_entity_index and the active_chunk_grid by value, and
+// those are defined next to their functions, which use chunk and world. So here they're templates
+// on them, only instantiated once both files are in.
+//
+struct wall{
+    v2s p[3];       // Counter-clockwise.
+    v2 normals[3];  // Outward, normals[i] is of the edge from p[i] to p[i + 1].
+};
+
+enum entity_type{
+    EntityType_Player,
+    EntityType_Enemy,
+    EntityType_Projectile,
+
+    EntityType_Count,
+};
+
+enum entity_flags{
+    EntityFlags_RemoveAtEndOfFrame = 0x1,
+};
+
+struct entity{
+    u64 eid;
+    entity_type type;
+    u32 flags;
+    v2s pos;
+    s32 entityIndexSlot;
+};
+
+struct entity_block{
+    entity_block *nextBlock;
+    s32 numEntitiesInBlock; // The entities follow the block header.
+};
+
+enum chunk_flags{
+    ChunkFlags_Active = 0x1,
+};
+
+template <typename index>
+struct chunk_with_index{
+    u32 flags;
+    entity_block *hotEntities;
+    index entityIndex;
+};
+struct chunk_entity_index;
+typedef chunk_with_index<chunk_entity_index> chunk;
+
+template <typename grid>
+struct world_with_grid{
+    s32 chunkSize;
+    v2s chunkMin;   // Chunks from chunkMin to chunkMax (inclusive) exist.
+    v2s chunkMax;
+    chunk *chunks;
+    grid activeChunks;
+};
+struct active_chunk_grid;
+typedef world_with_grid<active_chunk_grid> world;
+
+chunk *GetChunk(world *w, v2s chunkPos);
+
+#include "chunk_entity_index.cpp"
+#include "active_chunk_grid.cpp"
+
+inline s32 FloorDivS32(s32 a, s32 b){ return a/b - (a%b < 0 ? 1 : 0); }
+
+// - 0 if the chunk doesn't exist.
+chunk *GetChunk(world *w, v2s chunkPos){
+    if (chunkPos.x < w->chunkMin.x || chunkPos.x > w->chunkMax.x ||
+        chunkPos.y < w->chunkMin.y || chunkPos.y > w->chunkMax.y)
+        return 0;
+    s32 width = w->chunkMax.x - w->chunkMin.x + 1;
+    return &w->chunks[(chunkPos.y - w->chunkMin.y)*width + (chunkPos.x - w->chunkMin.x)];
+}
+
+inline v2s WorldPosToChunk(world *w, v2s pos){
+    v2s result = {FloorDivS32(pos.x, w->chunkSize), FloorDivS32(pos.y, w->chunkSize)};
+    return result;
+}
+
+inline v2s ChunkToWorldPos(world *w, v2s chunkPos){
+    v2s result = {chunkPos.x*w->chunkSize, chunkPos.y*w->chunkSize};
+    return result;
+}
+
+// - Inside the chunks that exist.
+inline v2s ClampWorldPos(world *w, v2s pos){
+    v2s min = ChunkToWorldPos(w, w->chunkMin);
+    v2s max = ChunkToWorldPos(w, w->chunkMax + V2S(1)) - V2S(1);
+    v2s result = {ClampS32(pos.x, min.x, max.x), ClampS32(pos.y, min.y, max.y)};
+    return result;
+}
+
+// - Every chunk from 'chunkMin' to 'chunkMax' exists, inactive and without entities.
+void MakeWorld(world *w, s32 chunkSize, v2s chunkMin, v2s chunkMax){
+    ZeroStruct(w);
+    w->chunkSize = chunkSize;
+    w->chunkMin = chunkMin;
+    w->chunkMax = chunkMax;
+    s32 numChunks = (chunkMax.x - chunkMin.x + 1)*(chunkMax.y - chunkMin.y + 1);
+    w->chunks = (chunk *)calloc(numChunks, sizeof(chunk));
+}
+
+void DestroyWorld(world *w){
+    s32 numChunks = (w->chunkMax.x - w->chunkMin.x + 1)*(w->chunkMax.y - w->chunkMin.y + 1);
+    for(s32 i = 0; i < numChunks; i++)
+        ChunkEntityIndex_Destruct(&w->chunks[i]);
+    ActiveChunkGrid_Destruct(&w->activeChunks);
+    free(w->chunks);
+    ZeroStruct(w);
+}
+
+
+#include "hash_table.h"
+#include "circle_wall_collision.cpp"
+#include "wall_grid.cpp"
+#include "entity_moving_circle_collision.cpp"
+#include "entity_moving_circle_batch.cpp"
+#include "collision_check.cpp"
+
+
+int main(){
+    s32 mismatches = 0;
+
+    // The same 4096x4096 region with small, medium and big chunks, in a world with a ring of
+    // chunks around it that the queries can reach but that have no entities.
+    s32 chunkSizes[] = {64, 256, 1024};
+    for(s32 i = 0; i < ArrayCount(chunkSizes); i++){
+        s32 chunkSize = chunkSizes[i];
+        v2s chunkMin = V2S(-2048/chunkSize);
+        v2s chunkMax = V2S(2048/chunkSize - 1);
+        world w;
+        MakeWorld(&w, chunkSize, chunkMin - V2S(2), chunkMax + V2S(2));
+        mismatches += CollisionCheck_EntityWorlds(&w, chunkMin, chunkMax, 2000, 77 + i);
+        DestroyWorld(&w);
+    }
+
+    local_persist wall walls[20000];
+    v2s min = {-50000, -50000};
+    v2s max = {50000, 50000};
+    collision_check_report report;
+
+    CollisionCheck_MakeWalls(walls, ArrayCount(walls), min, max, 800, 0, 7);
+    CollisionCheck_Walls(&report, walls, ArrayCount(walls), 1024, 20000, 300, 99);
+    CollisionCheck_Print("Walls, uniform", &report);
+    mismatches += report.mismatches;
+
+    CollisionCheck_MakeWalls(walls, ArrayCount(walls), min, max, 800, 8, 7);
+    CollisionCheck_Walls(&report, walls, ArrayCount(walls), 1024, 20000, 300, 99);
+    CollisionCheck_Print("Walls, clustered", &report);
+    mismatches += report.mismatches;
+
+    CollisionCheck_WallSweeps(&report, walls, ArrayCount(walls), 20000, 600, 200, 5);
+    CollisionCheck_Print("Wall sweeps", &report);
+    mismatches += report.mismatches;
+
+    CollisionCheck_MakeWalls(walls, 2000, min, max, 30, 0, 9);
+    CollisionCheck_WallSweeps(&report, walls, 2000, 20000, 600, 200, 6);
+    CollisionCheck_Print("Wall sweeps, small walls", &report);
+    mismatches += report.mismatches;
+
+    printf("%d mismatch(es).\n", mismatches);
+    return mismatches;
+}
@@ -0,0 +1,216 @@
+//
+// Many moving circle queries at once (like every projectile of the frame), spread over threads.
+//
+// Has a lot of unincluded context.
+//
+
+/*
+ - Same result as calling EntityMovingCircleCollisionNearest() for each query, but:
+     - Each chunk is looked up once, not once per query that touches it.
+     - All the queries that touch a chunk are tested against it together, while its entity index
+       is in cache, instead of going through the chunks again for every query.
+
+ - Usage:
+       MovingCircleBatch_Begin(&batch, w, queries, numQueries, results);
+       // MovingCircleBatch_Work(&batch) from as many threads as you want (e.g. push one work queue
+       // entry per worker thread and call it on this thread too), and wait for all of them.
+       MovingCircleBatch_End(&batch);
+
+ - Begin() bins the queries by the chunks they cover (one bin per chunk). Threads take bins with
+   an atomic counter, so a thread that got cheap bins just takes more of them.
+
+ - Every (query, chunk) pair has its own result slot, and End() reduces them with
+   EntityHitIsBefore(), which is a strict order (by 't' and then eid). So the results don't depend
+   on which thread processed what, or in which order.
+
+ - The world can't change between Begin() and End().
+*/
+
+struct moving_circle_batch_query{
+    v2s p0;
+    v2s p1;
+    s32 r;
+    entity_type entityType;
+    u64 eidException;
+};
+
+struct moving_circle_batch_bin_node{
+    u64 key; // Chunk position
+    u32 occupied;
+    s32 binIndex;
+};
+
+struct moving_circle_batch{
+    moving_circle_batch_query *queries;
+    s32 numQueries;
+    entity_hit *results; // One per query. 'e' is 0 if it didn't hit anything.
+
+    moving_circle_query *prepared; // One per query.
+    s32 numBins;
+    chunk **binChunks;
+    s32 *binFirstEntry;  // numBins + 1 offsets into entryQuery/entryHits.
+    s32 *entryQuery;
+    entity_hit *entryHits;
+    void *mem;
+
+    volatile s32 nextBin;
+};
+
+
+inline u64 MovingCircleBatch_ChunkKey(v2s chunkPos){
+    u64 result = (u64)(u32)chunkPos.x | ((u64)(u32)chunkPos.y << 32);
+    return result;
+}
+
+// - 'results' must fit 'numQueries' hits.
+void MovingCircleBatch_Begin(moving_circle_batch *batch, world *w, moving_circle_batch_query *queries,
+                             s32 numQueries, entity_hit *results){
+    TIMED_FUNCTION();
+    ZeroStruct(batch);
+    batch->queries = queries;
+    batch->numQueries = numQueries;
+    batch->results = results;
+    batch->prepared = (moving_circle_query *)malloc(sizeof(moving_circle_query)*MaxS32(numQueries, 1));
+
+    // Find the bins and count their entries. Bins are numbered in order of first use, so that they
+    // don't depend on the hash table layout.
+    hash_table<moving_circle_batch_bin_node> bins;
+    HashTable_Init(&bins, HashTable_NumTotalSlotsNeededForMaxOccupied(MaxS32(numQueries, 16)));
+    s32 binCapacity = 64;
+    chunk **binChunks = (chunk **)malloc(sizeof(chunk *)*binCapacity);
+    s32 *binCounts = (s32 *)malloc(sizeof(s32)*binCapacity);
+    s32 numEntries = 0;
+    for(s32 i = 0; i < numQueries; i++){
+        moving_circle_batch_query *query = &queries[i];
+        moving_circle_query *q = &batch->prepared[i];
+        *q = MovingCircleQuery(w, query->r, query->p1, query->p0);
+
+        for(s32 cx = q->chunkPosMin.x; cx <= q->chunkPosMax.x; cx++){
+            s32 minY, maxY;
+            if (!MovingCircleQuery_ChunkColumn(w, q, cx, &minY, &maxY))
+                continue;
+            for(s32 cy = minY; cy <= maxY; cy++){
+                v2s chunkPos = {cx, cy};
+                b32 got;
+                moving_circle_batch_bin_node *node = HashTable_GetOrAdd(&bins, MovingCircleBatch_ChunkKey(chunkPos), &got);
+                if (!got){
+                    chunk *c = ActiveChunkGrid_Get(&w->activeChunks, chunkPos);
+                    if (!c){
+                        node->binIndex = -1;
+                        continue;
+                    }
+                    if (batch->numBins == binCapacity){
+                        binCapacity *= 2;
+                        binChunks = (chunk **)realloc(binChunks, sizeof(chunk *)*binCapacity);
+                        binCounts = (s32 *)realloc(binCounts, sizeof(s32)*binCapacity);
+                    }
+                    node->binIndex = batch->numBins++;
+                    binChunks[node->binIndex] = c;
+                    binCounts[node->binIndex] = 0;
+                }
+                if (node->binIndex < 0)
+                    continue;
+                binCounts[node->binIndex]++;
+                numEntries++;
+            }
+        }
+    }
+
+    // Entries of each bin are contiguous, in query order.
+    umm memSize = (sizeof(chunk *)*batch->numBins + sizeof(s32)*(batch->numBins + 1) +
+                   (sizeof(s32) + sizeof(entity_hit))*numEntries);
+    batch->mem = malloc(memSize);
+    batch->entryHits = (entity_hit *)batch->mem;
+    batch->binChunks = (chunk **)(batch->entryHits + numEntries);
+    batch->entryQuery = (s32 *)(batch->binChunks + batch->numBins);
+    batch->binFirstEntry = batch->entryQuery + numEntries;
+
+    memcpy(batch->binChunks, binChunks, sizeof(chunk *)*batch->numBins);
+    batch->binFirstEntry[0] = 0;
+    for(s32 bin = 0; bin < batch->numBins; bin++){
+        batch->binFirstEntry[bin + 1] = batch->binFirstEntry[bin] + binCounts[bin];
+        binCounts[bin] = batch->binFirstEntry[bin]; // Now it's where the next entry goes.
+    }
+    for(s32 i = 0; i < numQueries; i++){
+        moving_circle_query *q = &batch->prepared[i];
+        for(s32 cx = q->chunkPosMin.x; cx <= q->chunkPosMax.x; cx++){
+            s32 minY, maxY;
+            if (!MovingCircleQuery_ChunkColumn(w, q, cx, &minY, &maxY))
+                continue;
+            for(s32 cy = minY; cy <= maxY; cy++){
+                v2s chunkPos = {cx, cy};
+                moving_circle_batch_bin_node *node = HashTable_Get(&bins, MovingCircleBatch_ChunkKey(chunkPos));
+                if (node->binIndex >= 0)
+                    batch->entryQuery[binCounts[node->binIndex]++] = i;
+            }
+        }
+    }
+
+    free(binChunks);
+    free(binCounts);
+    HashTable_Destruct(&bins);
+}
+
+// - Nearest hit of one query in one chunk.
+entity_hit MovingCircleBatch_NearestInChunk(moving_circle_query *q, chunk *c, entity_type entityType,
+                                            u64 eidException){
+    entity_hit best = {0, 2.f};
+    chunk_entity_type_index *index = &c->entityIndex.types[entityType];
+    CollisionQueryStat(chunksVisited, 1);
+    CollisionQueryStat(entitiesVisited, index->count);
+    for(s32 first = 0; first < index->count; first += 8){
+        u32 mask = MovingCircleQuery_Hits8(q, index, first, eidException);
+        for(; mask; mask &= mask - 1){
+            s32 i = first + CountTrailingZeros(mask);
+            v2s pos = {index->x[i], index->y[i]};
+            if (MovingCircleQuery_MinTimeOfHit(q, pos) > best.t)
+                continue;
+
+            entity_hit hit = {index->entities[i], MovingCircleQuery_TimeOfHit(q, pos)};
+            if (!best.e || EntityHitIsBefore(&hit, &best))
+                best = hit;
+        }
+    }
+    return best;
+}
+
+// - Can be called from many threads at the same time. Returns when there are no bins left.
+void MovingCircleBatch_Work(moving_circle_batch *batch){
+    TIMED_FUNCTION();
+    for(;;){
+        s32 bin = _InterlockedIncrement((volatile long *)&batch->nextBin) - 1;
+        if (bin >= batch->numBins)
+            break;
+
+        chunk *c = batch->binChunks[bin];
+        for(s32 entry = batch->binFirstEntry[bin]; entry < batch->binFirstEntry[bin + 1]; entry++){
+            s32 queryIndex = batch->entryQuery[entry];
+            moving_circle_batch_query *query = &batch->queries[queryIndex];
+            batch->entryHits[entry] = MovingCircleBatch_NearestInChunk(&batch->prepared[queryIndex], c,
+                                                                       query->entityType, query->eidException);
+        }
+    }
+}
+
+// - Call after every MovingCircleBatch_Work() call returned. Writes the results.
+void MovingCircleBatch_End(moving_circle_batch *batch){
+    TIMED_FUNCTION();
+    Assert(batch->nextBin >= batch->numBins);
+    for(s32 i = 0; i < batch->numQueries; i++){
+        batch->results[i].e = 0;
+        batch->results[i].t = 2.f;
+    }
+
+    s32 numEntries = batch->binFirstEntry[batch->numBins];
+    for(s32 entry = 0; entry < numEntries; entry++){
+        entity_hit *hit = &batch->entryHits[entry];
+        entity_hit *result = &batch->results[batch->entryQuery[entry]];
+        if (hit->e && (!result->e || EntityHitIsBefore(hit, result)))
+            *result = *hit;
+    }
+
+    free(batch->prepared);
+    free(batch->mem);
+    batch->prepared = 0;
+    batch->mem = 0;
+}
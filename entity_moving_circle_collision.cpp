@@ -5,69 +5,460 @@
 //
 
 
-// - Detects the collision between an entity (point) of a certain type, and a circle with radius
-// 'r' "slided" on a line from 'p0' to 'p1' (i.e. making a pill shape).
-// - Returns the first found entity that collided, or 0 if none.
-entity *EntityMovingCircleCollision(world *w, entity_type entityType, s32 r, v2s p1, v2s p0, u64 eidException = 0){
-    v2s lineCenter = p0 + (p1 - p0)/2;
+// Counts of what the queries visit, for collision_check.cpp. Compile with COLLISION_QUERY_STATS 1
+// to turn them on. They're atomic adds, so they're fine with MovingCircleBatch_Work() too.
+#ifndef COLLISION_QUERY_STATS
+#define COLLISION_QUERY_STATS 0
+#endif
+
+struct collision_query_stats{
+    volatile s64 queries;
+    volatile s64 chunksVisited;
+    volatile s64 entitiesVisited; // Positions tested.
+};
+
+global_variable collision_query_stats collisionQueryStats;
+
+#if COLLISION_QUERY_STATS
+#define CollisionQueryStat(member, n) _InterlockedExchangeAdd64(&collisionQueryStats.member, (s64)(n))
+#else
+#define CollisionQueryStat(member, n)
+#endif
+
+
+// Values of a moving circle query that don't depend on the entity.
+struct moving_circle_query{
+    s32 r;
+    v2s p0;
+    v2s p1;
+    v2s lineCenter;
+    s64 earlyOutCircleRSqr;
+    s64 rSqr;
+    v2 lineNormal;
+    v2 lineDirection;
+    f32 lineLength;
+
+    s32 chunkRadius; // 'r' plus the margin, for finding the chunks to visit.
+    v2s chunkPosMin;
+    v2s chunkPosMax;
+};
+
+// How far outside of the chunk that has it an entity can be (it moved, but hasn't been moved to the
+// other chunk yet). Queries grow their radius by this to find the chunks to visit.
+#define MOVING_CIRCLE_QUERY_CHUNK_MARGIN 100
+
+inline moving_circle_query MovingCircleQuery(world *w, s32 r, v2s p1, v2s p0){
+    moving_circle_query q;
+    CollisionQueryStat(queries, 1);
+    q.r = r;
+    q.p0 = p0;
+    q.p1 = p1;
+    q.lineCenter = p0 + (p1 - p0)/2;
 
-    s32 margin = 100;
+    s32 margin = MOVING_CIRCLE_QUERY_CHUNK_MARGIN;
+    q.chunkRadius = r + margin;
     v2s bboxMin = MinV2S(p0, p1) - V2S(r + margin);
     v2s bboxMax = MaxV2S(p0, p1) + V2S(r + margin);
 
-    v2s chunkPosMin = WorldPosToChunk(w, ClampWorldPos(w, bboxMin));
-    v2s chunkPosMax = WorldPosToChunk(w, ClampWorldPos(w, bboxMax));
+    q.chunkPosMin = WorldPosToChunk(w, ClampWorldPos(w, bboxMin));
+    q.chunkPosMax = WorldPosToChunk(w, ClampWorldPos(w, bboxMax));
 
     // Computing the intersection between a circle and a point is faster than between a circle
         // and line. So, we make a big circle that contains the "pill shape". If an entity collides
         // with this, then we'll check the more expensive line/circle collision.
-    s64 earlyOutCircleRSqr = SquareS64((s64)r + (s64)Length(V2(p1 - p0))/2);
-    s64 rSqr = SQUARE((s64)r);
+    q.lineLength = Length(V2(p1 - p0));
+    q.earlyOutCircleRSqr = SquareS64((s64)r + (s64)q.lineLength/2);
+    q.rSqr = SQUARE((s64)r);
+
+    q.lineDirection = V2(p1 - p0)/q.lineLength;
+    q.lineNormal = Rotate90Degrees(q.lineDirection);
+    return q;
+}
+
+// - Rows of chunks of column 'cx' that the pill shape (grown by the margin) can touch, instead of
+// the whole column of the bounding box. Conservative: the segment is clipped to the column grown by
+// 'chunkRadius', and its y range grown by 'chunkRadius' too (+1 for rounding).
+// - Returns false if it doesn't touch the column at all.
+// - 'outT0': if non 0, set to the time the circle can first reach the column. Lower bound of the
+//   MovingCircleQuery_MinTimeOfHit() of anything in it.
+inline b32 MovingCircleQuery_ChunkColumn(world *w, moving_circle_query *q, s32 cx, s32 *outMinY, s32 *outMaxY,
+                                         f32 *outT0 = 0){
+    f32 radius = (f32)q->chunkRadius + 1;
+    v2s chunkPos = {cx, 0};
+    v2s nextChunkPos = {cx + 1, 0};
+    v2s columnMin = ChunkToWorldPos(w, chunkPos);
+    v2s columnEnd = ChunkToWorldPos(w, nextChunkPos);
+    // Relative to p0, so that the floats stay small.
+    f32 slabMin = (f32)(columnMin.x - q->p0.x) - radius;
+    f32 slabMax = (f32)(columnEnd.x - 1 - q->p0.x) + radius;
+    v2 d = V2(q->p1 - q->p0);
+
+    f32 t0 = 0;
+    f32 t1 = 1.f;
+    if (d.x == 0){
+        if (slabMin > 0 || slabMax < 0)
+            return false;
+    }else{
+        f32 tSlab0 = slabMin/d.x;
+        f32 tSlab1 = slabMax/d.x;
+        t0 = MaxF32(t0, MinF32(tSlab0, tSlab1));
+        t1 = MinF32(t1, MaxF32(tSlab0, tSlab1));
+        if (t0 > t1)
+            return false;
+    }
+
+    if (outT0)
+        *outT0 = t0;
+
+    f32 y0 = d.y*t0;
+    f32 y1 = d.y*t1;
+    v2s minPos = {columnMin.x, q->p0.y + (s32)Floor(MinF32(y0, y1) - radius)};
+    v2s maxPos = {columnMin.x, q->p0.y + (s32)Floor(MaxF32(y0, y1) + radius) + 1};
+    *outMinY = MaxS32(WorldPosToChunk(w, ClampWorldPos(w, minPos)).y, q->chunkPosMin.y);
+    *outMaxY = MinS32(WorldPosToChunk(w, ClampWorldPos(w, maxPos)).y, q->chunkPosMax.y);
+    return (*outMinY <= *outMaxY);
+}
+
+// - True if the point 'pos' is inside the pill shape.
+inline b32 MovingCircleQuery_Test(moving_circle_query *q, v2s pos){
+    v2s delta = pos - q->lineCenter;
+    s64 disSqr = SQUARE((s64)delta.x) + SQUARE((s64)delta.y);
+    if (disSqr > q->earlyOutCircleRSqr)
+        return false;
+
+    // Check vertex circles
+    v2s delta0 = pos - q->p0;
+    v2s delta1 = pos - q->p1;
+    s64 disSqr0 = SQUARE((s64)delta0.x) + SQUARE((s64)delta0.y);
+    s64 disSqr1 = SQUARE((s64)delta1.x) + SQUARE((s64)delta1.y);
+
+    if (!(disSqr0 < q->rSqr || disSqr1 < q->rSqr)){
+        // Check segment rectangle
+        f32 lineDistance = Dot(q->lineNormal, V2(delta0));
+        if (Abs(lineDistance) > (f32)q->r)
+            return false;
+
+        f32 cross0 = Cross(q->lineNormal, V2(delta0));
+        f32 cross1 = Cross(q->lineNormal, V2(delta1));
+        if (cross0 > 0 || cross1 < 0)
+            return false;
+    }
+    return true;
+}
+
+// - When the moving circle first touches 'pos', from 0 (at 'p0') to 1 (at 'p1').
+inline f32 MovingCircleQuery_TimeOfHit(moving_circle_query *q, v2s pos){
+    if (q->lineLength <= 0)
+        return 0;
+    v2 delta0 = V2(pos - q->p0);
+    f32 along = Dot(q->lineDirection, delta0);
+    f32 sideSqr = MaxF32(LengthSqr(delta0) - along*along, 0);
+    f32 back = Sqrt(MaxF32((f32)q->rSqr - sideSqr, 0));
+    f32 result = Clamp((along - back)/q->lineLength, 0, 1.f);
+    return result;
+}
+
+// - Lower bound of MovingCircleQuery_TimeOfHit(), without the square root.
+inline f32 MovingCircleQuery_MinTimeOfHit(moving_circle_query *q, v2s pos){
+    if (q->lineLength <= 0)
+        return 0;
+    f32 along = Dot(q->lineDirection, V2(pos - q->p0));
+    f32 result = (along - (f32)q->r)/q->lineLength;
+    return result;
+}
+
+// - Lower bound of MovingCircleQuery_MinTimeOfHit() for every entity stored in the chunk: the one
+// of its corner that's furthest back along the line, with 'chunkRadius' instead of 'r' (entities
+// can be up to the margin outside of the chunk that has them, like for MovingCircleQuery_ChunkColumn)
+// and 1 more unit for the rounding.
+inline f32 MovingCircleQuery_ChunkMinTimeOfHit(world *w, moving_circle_query *q, v2s chunkPos){
+    if (q->lineLength <= 0)
+        return 0;
+    v2s nextChunkPos = {chunkPos.x + 1, chunkPos.y + 1};
+    v2s chunkMin = ChunkToWorldPos(w, chunkPos);
+    v2s chunkEnd = ChunkToWorldPos(w, nextChunkPos);
+    f32 x = (f32)((q->lineDirection.x >= 0 ? chunkMin.x : chunkEnd.x - 1) - q->p0.x);
+    f32 y = (f32)((q->lineDirection.y >= 0 ? chunkMin.y : chunkEnd.y - 1) - q->p0.y);
+    f32 along = q->lineDirection.x*x + q->lineDirection.y*y;
+    f32 result = (along - (f32)q->chunkRadius - 1.f)/q->lineLength;
+    return result;
+}
+
+
+//
+// 8 entities at a time
+//
+// MovingCircleQuery_Test() on 8 positions of a chunk_entity_index, as a mask. The s64 distance
+// checks are done in s64 lanes and the f32 ones with the same operations in the same order, so the
+// results are exactly the same as the scalar version (as long as the compiler doesn't contract
+// that one into FMAs).
+//
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+// - Squared length of (x, y) in s64, for the even (0, 2, 4, 6) and odd 32 bit lanes.
+inline void MovingCircleQuery_LengthSqr8(__m256i x, __m256i y, __m256i *outEven, __m256i *outOdd){
+    __m256i xOdd = _mm256_srli_epi64(x, 32);
+    __m256i yOdd = _mm256_srli_epi64(y, 32);
+    *outEven = _mm256_add_epi64(_mm256_mul_epi32(x, x), _mm256_mul_epi32(y, y));
+    *outOdd  = _mm256_add_epi64(_mm256_mul_epi32(xOdd, xOdd), _mm256_mul_epi32(yOdd, yOdd));
+}
+
+// - Puts back together the s64 comparisons of the even and odd lanes as a 32 bit lane mask.
+inline __m256 MovingCircleQuery_MergeMask8(__m256i even, __m256i odd){
+    __m256 result = _mm256_castsi256_ps(_mm256_blend_epi32(even, odd, 0xAA));
+    return result;
+}
+
+inline u32 MovingCircleQuery_Test8(moving_circle_query *q, s32 *xs, s32 *ys){
+    __m256i x = _mm256_loadu_si256((__m256i *)xs);
+    __m256i y = _mm256_loadu_si256((__m256i *)ys);
+
+    // Big circle early out
+    __m256i even, odd;
+    MovingCircleQuery_LengthSqr8(_mm256_sub_epi32(x, _mm256_set1_epi32(q->lineCenter.x)),
+                                 _mm256_sub_epi32(y, _mm256_set1_epi32(q->lineCenter.y)), &even, &odd);
+    __m256i earlyOutRSqr = _mm256_set1_epi64x(q->earlyOutCircleRSqr);
+    __m256 outsideBigCircle = MovingCircleQuery_MergeMask8(_mm256_cmpgt_epi64(even, earlyOutRSqr),
+                                                           _mm256_cmpgt_epi64(odd, earlyOutRSqr));
+
+    // Vertex circles
+    __m256i rSqr = _mm256_set1_epi64x(q->rSqr);
+    __m256i dx0 = _mm256_sub_epi32(x, _mm256_set1_epi32(q->p0.x));
+    __m256i dy0 = _mm256_sub_epi32(y, _mm256_set1_epi32(q->p0.y));
+    __m256i dx1 = _mm256_sub_epi32(x, _mm256_set1_epi32(q->p1.x));
+    __m256i dy1 = _mm256_sub_epi32(y, _mm256_set1_epi32(q->p1.y));
+    MovingCircleQuery_LengthSqr8(dx0, dy0, &even, &odd);
+    __m256 inCircle0 = MovingCircleQuery_MergeMask8(_mm256_cmpgt_epi64(rSqr, even), _mm256_cmpgt_epi64(rSqr, odd));
+    MovingCircleQuery_LengthSqr8(dx1, dy1, &even, &odd);
+    __m256 inCircle1 = MovingCircleQuery_MergeMask8(_mm256_cmpgt_epi64(rSqr, even), _mm256_cmpgt_epi64(rSqr, odd));
+
+    // Segment rectangle. The ordered compares are false for NaN (a query with p0 == p1), like
+    // the scalar ones.
+    __m256 nx = _mm256_set1_ps(q->lineNormal.x);
+    __m256 ny = _mm256_set1_ps(q->lineNormal.y);
+    __m256 fx0 = _mm256_cvtepi32_ps(dx0);
+    __m256 fy0 = _mm256_cvtepi32_ps(dy0);
+    __m256 fx1 = _mm256_cvtepi32_ps(dx1);
+    __m256 fy1 = _mm256_cvtepi32_ps(dy1);
+    __m256 lineDistance = _mm256_add_ps(_mm256_mul_ps(nx, fx0), _mm256_mul_ps(ny, fy0));
+    __m256 absLineDistance = _mm256_andnot_ps(_mm256_set1_ps(-0.f), lineDistance);
+    __m256 cross0 = _mm256_sub_ps(_mm256_mul_ps(nx, fy0), _mm256_mul_ps(ny, fx0));
+    __m256 cross1 = _mm256_sub_ps(_mm256_mul_ps(nx, fy1), _mm256_mul_ps(ny, fx1));
+    __m256 outsideRect = _mm256_or_ps(_mm256_cmp_ps(absLineDistance, _mm256_set1_ps((f32)q->r), _CMP_GT_OQ),
+                                      _mm256_or_ps(_mm256_cmp_ps(cross0, _mm256_setzero_ps(), _CMP_GT_OQ),
+                                                   _mm256_cmp_ps(cross1, _mm256_setzero_ps(), _CMP_LT_OQ)));
 
-    v2 lineNormal = Rotate90Degrees(V2(p1 - p0)/Length(V2(p1 - p0)));
+    __m256 allOnes = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    __m256 inside = _mm256_or_ps(_mm256_or_ps(inCircle0, inCircle1), _mm256_xor_ps(outsideRect, allOnes));
+    u32 result = (u32)_mm256_movemask_ps(_mm256_andnot_ps(outsideBigCircle, inside));
+    return result;
+}
+
+#else
+
+inline u32 MovingCircleQuery_Test8(moving_circle_query *q, s32 *xs, s32 *ys){
+    u32 result = 0;
+    for(s32 i = 0; i < 8; i++){
+        v2s pos = {xs[i], ys[i]};
+        if (MovingCircleQuery_Test(q, pos))
+            result |= 1u << i;
+    }
+    return result;
+}
+
+#endif
+
+// - Mask of the entities 'first' to 'first' + 7 of 'index' that are inside the pill shape, are not
+// 'eidException', and are not being removed.
+// - Reads 8 positions even past 'count'. That's fine because 'capacity' is always a multiple of 8.
+u32 MovingCircleQuery_Hits8(moving_circle_query *q, chunk_entity_type_index *index, s32 first,
+                            u64 eidException){
+    Assert(first + 8 <= index->capacity);
+    u32 mask = MovingCircleQuery_Test8(q, index->x + first, index->y + first);
+    s32 numValid = index->count - first;
+    if (numValid < 8)
+        mask &= (1u << numValid) - 1;
+
+    // Few lanes hit, so filter those one by one.
+    for(u32 scan = mask; scan; scan &= scan - 1){
+        s32 i = first + CountTrailingZeros(scan);
+        if (index->eid[i] == eidException || (index->entities[i]->flags & EntityFlags_RemoveAtEndOfFrame))
+            mask &= ~(1u << (i - first));
+    }
+    return mask;
+}
+
+
+// - Detects the collision between an entity (point) of a certain type, and a circle with radius
+// 'r' "slided" on a line from 'p0' to 'p1' (i.e. making a pill shape).
+// - Returns the first found entity that collided, or 0 if none.
+// - The first found is not necessarily the closest to 'p0'. For that use
+// EntityMovingCircleCollisionNearest() or EntityMovingCircleCollisionAll().
+entity *EntityMovingCircleCollision(world *w, entity_type entityType, s32 r, v2s p1, v2s p0, u64 eidException = 0){
+    TIMED_FUNCTION();
+    moving_circle_query q = MovingCircleQuery(w, r, p1, p0);
+
+    for(s32 cx = q.chunkPosMin.x; cx <= q.chunkPosMax.x; cx++){
+        s32 minY, maxY;
+        if (!MovingCircleQuery_ChunkColumn(w, &q, cx, &minY, &maxY))
+            continue;
+        for(s32 cy = minY; cy <= maxY; cy++){
+            v2s chunkPos = {cx, cy};
+            chunk *c = ActiveChunkGrid_Get(&w->activeChunks, chunkPos);
+            if (c){
+                // Only the positions of this type (see chunk_entity_index.cpp).
+                chunk_entity_type_index *index = &c->entityIndex.types[entityType];
+                CollisionQueryStat(chunksVisited, 1);
+                CollisionQueryStat(entitiesVisited, index->count);
+                for(s32 first = 0; first < index->count; first += 8){
+                    u32 mask = MovingCircleQuery_Hits8(&q, index, first, eidException);
+                    if (mask)
+                        return index->entities[first + CountTrailingZeros(mask)];
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+
+struct entity_hit{
+    entity *e;
+    f32 t; // When the moving circle touches it, from 0 (at 'p0') to 1 (at 'p1').
+};
+
+// - By 't', and by eid when equal so that the order doesn't depend on memory layout.
+inline b32 EntityHitIsBefore(entity_hit *a, entity_hit *b){
+    b32 result = (a->t < b->t || (a->t == b->t && a->e->eid < b->e->eid));
+    return result;
+}
+
+void SortEntityHits(entity_hit *hits, s32 count){
+    for(s32 i = 1; i < count; i++){
+        entity_hit hit = hits[i];
+        s32 j = i;
+        for(; j > 0 && EntityHitIsBefore(&hit, &hits[j - 1]); j--){
+            hits[j] = hits[j - 1];
+        }
+        hits[j] = hit;
+    }
+}
 
-    for(s32 cx = chunkPosMin.x; cx <= chunkPosMax.x; cx++){
-        for(s32 cy = chunkPosMin.y; cy <= chunkPosMax.y; cy++){
+// - Like EntityMovingCircleCollision(), but collects every entity that collides in 'outHits', with
+// the time when the circle touches it. One pass over the chunks.
+// - If there are more than 'maxHits', keeps the 'maxHits' nearest ones (lowest 't'). So with a
+// small 'maxHits' this is a "nearest K" query.
+// - If 'sort', the hits are sorted by 't'. Otherwise they're in no particular order.
+// - Returns the number of hits written.
+s32 EntityMovingCircleCollisionAll(world *w, entity_type entityType, s32 r, v2s p1, v2s p0,
+                                   entity_hit *outHits, s32 maxHits, b32 sort, u64 eidException = 0){
+    TIMED_FUNCTION();
+    Assert(maxHits > 0);
+    moving_circle_query q = MovingCircleQuery(w, r, p1, p0);
+
+    s32 count = 0;
+    b32 full = false; // Once full, 'outHits' stays sorted so that the last one is the farthest.
+    for(s32 cx = q.chunkPosMin.x; cx <= q.chunkPosMax.x; cx++){
+        s32 minY, maxY;
+        if (!MovingCircleQuery_ChunkColumn(w, &q, cx, &minY, &maxY))
+            continue;
+        for(s32 cy = minY; cy <= maxY; cy++){
             v2s chunkPos = {cx, cy};
-            auto c = GetChunk(w, chunkPos);
-            if (c && (c->flags & ChunkFlags_Active)){
-                for(auto block = c->hotEntities; block; block = block->nextBlock){
-                    for(u16 i = 0; i < block->numEntitiesInBlock; i++){
-                        auto e = (entity *)(block + 1) + i;
-                        if (e->type != entityType || (e->flags & EntityFlags_RemoveAtEndOfFrame))
-                            continue;
-
-                        v2s delta = e->pos - lineCenter;
-                        s64 disSqr = SQUARE((s64)delta.x) + SQUARE((s64)delta.y);
-                        if (disSqr > earlyOutCircleRSqr)
-                            continue;
-
-                        // Check vertex circles
-                        v2s delta0 = e->pos - p0;
-                        v2s delta1 = e->pos - p1;
-                        s64 disSqr0 = SQUARE((s64)delta0.x) + SQUARE((s64)delta0.y);
-                        s64 disSqr1 = SQUARE((s64)delta1.x) + SQUARE((s64)delta1.y);
-
-                        if (!(disSqr0 < rSqr || disSqr1 < rSqr)){
-                            // Check segment rectangle
-                            f32 lineDistance = Dot(lineNormal, V2(delta0));
-                            if (Abs(lineDistance) > (f32)r)
-                                continue;
-
-                            f32 cross0 = Cross(lineNormal, V2(delta0));
-                            f32 cross1 = Cross(lineNormal, V2(delta1));
-                            if (cross0 > 0 || cross1 < 0)
-                                continue;
+            chunk *c = ActiveChunkGrid_Get(&w->activeChunks, chunkPos);
+            if (!c)
+                continue;
+
+            chunk_entity_type_index *index = &c->entityIndex.types[entityType];
+            CollisionQueryStat(chunksVisited, 1);
+            CollisionQueryStat(entitiesVisited, index->count);
+            for(s32 first = 0; first < index->count; first += 8){
+                u32 mask = MovingCircleQuery_Hits8(&q, index, first, eidException);
+                for(; mask; mask &= mask - 1){
+                    s32 i = first + CountTrailingZeros(mask);
+                    v2s pos = {index->x[i], index->y[i]};
+                    if (full && MovingCircleQuery_MinTimeOfHit(&q, pos) > outHits[maxHits - 1].t)
+                        continue;
+
+                    entity_hit hit = {index->entities[i], MovingCircleQuery_TimeOfHit(&q, pos)};
+                    if (!full){
+                        outHits[count++] = hit;
+                        if (count == maxHits){
+                            SortEntityHits(outHits, count);
+                            full = true;
                         }
-                        
-                        if (e->eid == eidException)
-                            continue;
+                    }else if (EntityHitIsBefore(&hit, &outHits[maxHits - 1])){
+                        // Replace the farthest and put it in place.
+                        outHits[maxHits - 1] = hit;
+                        SortEntityHits(outHits, maxHits);
+                    }
+                }
+            }
+        }
+    }
+    if (sort && !full)
+        SortEntityHits(outHits, count);
+    return count;
+}
 
-                        return e;
+// - Returns the entity that the moving circle touches first (lowest 't'), or 0 if none.
+// - 'outT': if non 0 and there's a result, it's set to its 't'.
+// - Chunks are visited starting from the 'p0' side. Entities that can't be closer than the current
+// best are skipped without testing them, and so are whole chunks: the chunks that come next in a
+// column, or the columns that come next, can't be reached any sooner, so it stops there.
+entity *EntityMovingCircleCollisionNearest(world *w, entity_type entityType, s32 r, v2s p1, v2s p0,
+                                           u64 eidException = 0, f32 *outT = 0){
+    TIMED_FUNCTION();
+    moving_circle_query q = MovingCircleQuery(w, r, p1, p0);
+
+    s32 stepX = (p1.x >= p0.x ? 1 : -1);
+    s32 stepY = (p1.y >= p0.y ? 1 : -1);
+    s32 firstX = (stepX > 0 ? q.chunkPosMin.x : q.chunkPosMax.x);
+    s32 numX = q.chunkPosMax.x - q.chunkPosMin.x + 1;
+
+    entity *best = 0;
+    f32 bestT = 2.f;
+    for(s32 ix = 0; ix < numX; ix++){
+        s32 cx = firstX + ix*stepX;
+        s32 minY, maxY;
+        f32 columnT0;
+        if (!MovingCircleQuery_ChunkColumn(w, &q, cx, &minY, &maxY, &columnT0))
+            continue;
+        if (columnT0 > bestT)
+            break;
+        s32 firstY = (stepY > 0 ? minY : maxY);
+        s32 numY = maxY - minY + 1;
+        for(s32 iy = 0; iy < numY; iy++){
+            v2s chunkPos = {cx, firstY + iy*stepY};
+            if (best && MovingCircleQuery_ChunkMinTimeOfHit(w, &q, chunkPos) > bestT)
+                break;
+            chunk *c = ActiveChunkGrid_Get(&w->activeChunks, chunkPos);
+            if (!c)
+                continue;
+
+            chunk_entity_type_index *index = &c->entityIndex.types[entityType];
+            CollisionQueryStat(chunksVisited, 1);
+            CollisionQueryStat(entitiesVisited, index->count);
+            for(s32 first = 0; first < index->count; first += 8){
+                u32 mask = MovingCircleQuery_Hits8(&q, index, first, eidException);
+                for(; mask; mask &= mask - 1){
+                    s32 i = first + CountTrailingZeros(mask);
+                    v2s pos = {index->x[i], index->y[i]};
+                    if (MovingCircleQuery_MinTimeOfHit(&q, pos) > bestT)
+                        continue;
+
+                    entity_hit hit = {index->entities[i], MovingCircleQuery_TimeOfHit(&q, pos)};
+                    entity_hit bestHit = {best, bestT};
+                    if (!best || EntityHitIsBefore(&hit, &bestHit)){
+                        best = hit.e;
+                        bestT = hit.t;
                     }
                 }
             }
         }
     }
-    return 0;
+    if (outT && best)
+        *outT = bestT;
+    return best;
 }
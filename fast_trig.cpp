@@ -0,0 +1,401 @@
+//
+// Fast sin, cos and atan2 to go with angle_functions.cpp, for when libm shows up in the profiles
+// (steering and facing of thousands of entities).
+//
+// Has a bit of unincluded context.
+//
+
+/*
+ - Two sin/cos variants:
+     - Polynomial (FastSin, FastCos, FastSinCos): reduce to [-PI, PI], fold to [-PI/2, PI/2]
+       and evaluate a degree 9 odd polynomial.
+       Max abs error 2.8e-7 (f32 rounding dominates, the polynomial itself is 3.4e-9).
+     - Table (FastSinTable, FastCosTable): linear interpolation of the compile-time table from
+       binary_angle.h. Max abs error 4.8e-6. Cheaper to evaluate, but it reads memory, so prefer
+       it only if you're not already cache-bound.
+
+ - The fast reduction (3-part 2*PI) is only exact for |x| <= FAST_TRIG_MAX_FAST_INPUT. Anything
+   bigger (or inf/NaN) goes to libm, which reduces exactly: the error bounds hold for every f32,
+   but those inputs are as slow as libm. Game angles never get there if they're normalized now
+   and then.
+
+ - FastAtan2: octant reduction and a degree 15 odd polynomial on [0, 1].
+   Max abs error 3.2e-7. Range [-PI, PI] like atan2(), -PI only for negative y too small to move
+   the result away from it.
+   Deliberate differences with libm for zeros: FastAtan2(+-0, +-0) is 0 (atan2() gives +-0 or +-PI
+   depending on the signs), and FastAtan2(-0, x < 0) is PI, where atan2() gives -PI. The
+   sign of a zero y usually comes from rounding, not from which side of the x axis a direction is
+   on, and a caller that wraps the result to [0, 2*PI) gets the same angle for +0 and -0 this way.
+
+ - The *Batch functions do 8 at a time with AVX2 (the table ones with gathers) and use the scalar
+   functions for the rest (or for everything if there's no AVX2). Both do the same operations in the same order, and blocks with
+   inputs for libm go through the scalar functions, so the results are the same to the bit.
+   'out' can be the same array as the input.
+
+ - FastTrig_Check() (fast_trig_check.cpp) measures all of this against f64 libm over every f32.
+*/
+
+#include <math.h>
+#include "binary_angle.h"
+
+
+// 2*PI (the real one, not the f32 PI) split in three so that k*FAST_TRIG_TWO_PI_HI and
+// k*FAST_TRIG_TWO_PI_MID are exact for |k| < 4096.
+// FAST_TRIG_MAX_FAST_INPUT keeps |k| <= 1304, inputs past it use libm.
+#define FAST_TRIG_TWO_PI_HI  6.28125f
+#define FAST_TRIG_TWO_PI_MID 1.9354820251464844e-3f
+#define FAST_TRIG_TWO_PI_LO  -1.7484555e-7f
+#define FAST_TRIG_INV_TWO_PI 0.159154937f
+#define FAST_TRIG_HALF_PI    1.57079633f
+#define FAST_TRIG_MAX_FAST_INPUT 8192.f
+
+// sin(x) ~= x*(S0 + x^2*(S1 + x^2*(S2 + ...))) on [-PI/2, PI/2]
+#define FAST_TRIG_S0  9.9999997663e-01f
+#define FAST_TRIG_S1 -1.6666647653e-01f
+#define FAST_TRIG_S2  8.3329000773e-03f
+#define FAST_TRIG_S3 -1.9800910949e-04f
+#define FAST_TRIG_S4  2.5905115793e-06f
+
+// atan(t) ~= t*(A0 + t^2*(A1 + t^2*(A2 + ...))) on [0, 1]
+#define FAST_TRIG_A0  9.9999933233e-01f
+#define FAST_TRIG_A1 -3.3329848234e-01f
+#define FAST_TRIG_A2  1.9946427542e-01f
+#define FAST_TRIG_A3 -1.3907963761e-01f
+#define FAST_TRIG_A4  9.6405553763e-02f
+#define FAST_TRIG_A5 -5.5890686604e-02f
+#define FAST_TRIG_A6  2.1848453819e-02f
+#define FAST_TRIG_A7 -4.0506826131e-03f
+
+
+// Range [-PI, PI] (in real PI).
+// - |x| <= FAST_TRIG_MAX_FAST_INPUT.
+inline f32 FastTrig_Reduce(f32 x){
+    f32 k = floorf(x*FAST_TRIG_INV_TWO_PI + .5f);
+    f32 result = ((x - k*FAST_TRIG_TWO_PI_HI) - k*FAST_TRIG_TWO_PI_MID) - k*FAST_TRIG_TWO_PI_LO;
+    return result;
+}
+
+// - 'x' in range [-PI, PI].
+inline f32 FastTrig_SinReduced(f32 x){
+    // sin(x) == sin(PI - x) == sin(-PI - x)
+    x = (x >  FAST_TRIG_HALF_PI ?  PI - x : x);
+    x = (x < -FAST_TRIG_HALF_PI ? -PI - x : x);
+    f32 x2 = x*x;
+    f32 result = FAST_TRIG_S4;
+    result = result*x2 + FAST_TRIG_S3;
+    result = result*x2 + FAST_TRIG_S2;
+    result = result*x2 + FAST_TRIG_S1;
+    result = result*x2 + FAST_TRIG_S0;
+    result *= x;
+    return result;
+}
+
+// - 'x' in range [-PI, PI]. Returns 'x' + PI/2 in range [-PI, PI].
+inline f32 FastTrig_QuarterTurn(f32 x){
+    x += FAST_TRIG_HALF_PI;
+    x -= (x > PI ? 2*PI : 0);
+    return x;
+}
+
+// - False for inf and NaN too.
+inline b32 FastTrig_IsFastInput(f32 x){
+    b32 result = (fabsf(x) <= FAST_TRIG_MAX_FAST_INPUT);
+    return result;
+}
+
+inline f32 FastSin(f32 x){
+    if (!FastTrig_IsFastInput(x))
+        return (f32)sin((f64)x);
+    f32 result = FastTrig_SinReduced(FastTrig_Reduce(x));
+    return result;
+}
+
+inline f32 FastCos(f32 x){
+    if (!FastTrig_IsFastInput(x))
+        return (f32)cos((f64)x);
+    f32 result = FastTrig_SinReduced(FastTrig_QuarterTurn(FastTrig_Reduce(x)));
+    return result;
+}
+
+inline void FastSinCos(f32 x, f32 *outSin, f32 *outCos){
+    if (!FastTrig_IsFastInput(x)){
+        *outSin = (f32)sin((f64)x);
+        *outCos = (f32)cos((f64)x);
+        return;
+    }
+    f32 reduced = FastTrig_Reduce(x);
+    *outSin = FastTrig_SinReduced(reduced);
+    *outCos = FastTrig_SinReduced(FastTrig_QuarterTurn(reduced));
+}
+
+// Range [-PI, PI] (see the top of the file)
+inline f32 FastAtan2(f32 y, f32 x){
+    f32 ax = fabsf(x);
+    f32 ay = fabsf(y);
+    f32 big   = (ax > ay ? ax : ay);
+    f32 small = (ax > ay ? ay : ax);
+    f32 t = small/(big > 0 ? big : 1.f); // (0, 0) gives 0.
+
+    f32 t2 = t*t;
+    f32 result = FAST_TRIG_A7;
+    result = result*t2 + FAST_TRIG_A6;
+    result = result*t2 + FAST_TRIG_A5;
+    result = result*t2 + FAST_TRIG_A4;
+    result = result*t2 + FAST_TRIG_A3;
+    result = result*t2 + FAST_TRIG_A2;
+    result = result*t2 + FAST_TRIG_A1;
+    result = result*t2 + FAST_TRIG_A0;
+    result *= t;
+
+    result = (ay > ax ? FAST_TRIG_HALF_PI - result : result);
+    result = (x < 0 ? PI - result : result);
+    result = (y < 0 ? -result : result); // Not signbit(): (-0, -1) is PI, not -PI (see the top of the file).
+    return result;
+}
+
+
+
+//
+// Table variants
+//
+
+struct fast_trig_sin_table{
+    f32 values[BINARY_ANGLE_SIN_TABLE_SIZE + 1];
+};
+
+constexpr fast_trig_sin_table FastTrig_MakeSinTable(){
+    fast_trig_sin_table table = {};
+    for(s32 i = 0; i <= BINARY_ANGLE_SIN_TABLE_SIZE; i++)
+        table.values[i] = (f32)binaryAngleSinTable.values[i]*(1.f/BINARY_ANGLE_ONE_Q30);
+    return table;
+}
+
+constexpr fast_trig_sin_table fastTrigSinTable = FastTrig_MakeSinTable();
+
+// - 'turns' is the angle in full turns, any value.
+inline f32 FastTrig_SinTableTurns(f32 turns){
+    turns -= floorf(turns);
+    f32 position = turns*(f32)BINARY_ANGLE_SIN_TABLE_SIZE;
+    s32 index = (s32)position;
+    index = (index < BINARY_ANGLE_SIN_TABLE_SIZE ? index : BINARY_ANGLE_SIN_TABLE_SIZE - 1);
+    f32 frac = position - (f32)index;
+    f32 s0 = fastTrigSinTable.values[index];
+    f32 s1 = fastTrigSinTable.values[index + 1];
+    f32 result = s0 + (s1 - s0)*frac;
+    return result;
+}
+
+inline f32 FastSinTable(f32 x){
+    if (!FastTrig_IsFastInput(x))
+        return (f32)sin((f64)x);
+    f32 result = FastTrig_SinTableTurns(FastTrig_Reduce(x)*FAST_TRIG_INV_TWO_PI);
+    return result;
+}
+
+inline f32 FastCosTable(f32 x){
+    if (!FastTrig_IsFastInput(x))
+        return (f32)cos((f64)x);
+    f32 result = FastTrig_SinTableTurns(FastTrig_Reduce(x)*FAST_TRIG_INV_TWO_PI + .25f);
+    return result;
+}
+
+
+
+//
+// Batch versions
+//
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+// - False if any of the 8 needs libm (see FastTrig_IsFastInput).
+inline b32 FastTrig_AreFastInputs8(__m256 x){
+    __m256 abs = _mm256_andnot_ps(_mm256_set1_ps(-0.f), x);
+    // _CMP_LE_OQ is false for NaN.
+    __m256 fast = _mm256_cmp_ps(abs, _mm256_set1_ps(FAST_TRIG_MAX_FAST_INPUT), _CMP_LE_OQ);
+    b32 result = (_mm256_movemask_ps(fast) == 0xFF);
+    return result;
+}
+
+inline __m256 FastTrig_Reduce8(__m256 x){
+    __m256 k = _mm256_floor_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(FAST_TRIG_INV_TWO_PI)),
+                                             _mm256_set1_ps(.5f)));
+    __m256 result = _mm256_sub_ps(x, _mm256_mul_ps(k, _mm256_set1_ps(FAST_TRIG_TWO_PI_HI)));
+    result = _mm256_sub_ps(result, _mm256_mul_ps(k, _mm256_set1_ps(FAST_TRIG_TWO_PI_MID)));
+    result = _mm256_sub_ps(result, _mm256_mul_ps(k, _mm256_set1_ps(FAST_TRIG_TWO_PI_LO)));
+    return result;
+}
+
+inline __m256 FastTrig_SinReduced8(__m256 x){
+    __m256 halfPi = _mm256_set1_ps(FAST_TRIG_HALF_PI);
+    __m256 pi = _mm256_set1_ps(PI);
+    x = _mm256_blendv_ps(x, _mm256_sub_ps(pi, x), _mm256_cmp_ps(x, halfPi, _CMP_GT_OQ));
+    x = _mm256_blendv_ps(x, _mm256_sub_ps(_mm256_sub_ps(_mm256_setzero_ps(), pi), x),
+                         _mm256_cmp_ps(x, _mm256_sub_ps(_mm256_setzero_ps(), halfPi), _CMP_LT_OQ));
+    __m256 x2 = _mm256_mul_ps(x, x);
+    __m256 result = _mm256_set1_ps(FAST_TRIG_S4);
+    result = _mm256_add_ps(_mm256_mul_ps(result, x2), _mm256_set1_ps(FAST_TRIG_S3));
+    result = _mm256_add_ps(_mm256_mul_ps(result, x2), _mm256_set1_ps(FAST_TRIG_S2));
+    result = _mm256_add_ps(_mm256_mul_ps(result, x2), _mm256_set1_ps(FAST_TRIG_S1));
+    result = _mm256_add_ps(_mm256_mul_ps(result, x2), _mm256_set1_ps(FAST_TRIG_S0));
+    result = _mm256_mul_ps(result, x);
+    return result;
+}
+
+inline __m256 FastTrig_QuarterTurn8(__m256 x){
+    x = _mm256_add_ps(x, _mm256_set1_ps(FAST_TRIG_HALF_PI));
+    __m256 tooBig = _mm256_cmp_ps(x, _mm256_set1_ps(PI), _CMP_GT_OQ);
+    x = _mm256_sub_ps(x, _mm256_and_ps(tooBig, _mm256_set1_ps(2*PI)));
+    return x;
+}
+
+inline __m256 FastAtan2_8(__m256 y, __m256 x){
+    __m256 signMask = _mm256_set1_ps(-0.f);
+    __m256 ax = _mm256_andnot_ps(signMask, x);
+    __m256 ay = _mm256_andnot_ps(signMask, y);
+    __m256 big   = _mm256_max_ps(ax, ay);
+    __m256 small = _mm256_min_ps(ax, ay);
+    __m256 bigIsZero = _mm256_cmp_ps(big, _mm256_setzero_ps(), _CMP_LE_OQ);
+    __m256 t = _mm256_div_ps(small, _mm256_blendv_ps(big, _mm256_set1_ps(1.f), bigIsZero));
+
+    __m256 t2 = _mm256_mul_ps(t, t);
+    __m256 result = _mm256_set1_ps(FAST_TRIG_A7);
+    result = _mm256_add_ps(_mm256_mul_ps(result, t2), _mm256_set1_ps(FAST_TRIG_A6));
+    result = _mm256_add_ps(_mm256_mul_ps(result, t2), _mm256_set1_ps(FAST_TRIG_A5));
+    result = _mm256_add_ps(_mm256_mul_ps(result, t2), _mm256_set1_ps(FAST_TRIG_A4));
+    result = _mm256_add_ps(_mm256_mul_ps(result, t2), _mm256_set1_ps(FAST_TRIG_A3));
+    result = _mm256_add_ps(_mm256_mul_ps(result, t2), _mm256_set1_ps(FAST_TRIG_A2));
+    result = _mm256_add_ps(_mm256_mul_ps(result, t2), _mm256_set1_ps(FAST_TRIG_A1));
+    result = _mm256_add_ps(_mm256_mul_ps(result, t2), _mm256_set1_ps(FAST_TRIG_A0));
+    result = _mm256_mul_ps(result, t);
+
+    result = _mm256_blendv_ps(result, _mm256_sub_ps(_mm256_set1_ps(FAST_TRIG_HALF_PI), result),
+                              _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+    result = _mm256_blendv_ps(result, _mm256_sub_ps(_mm256_set1_ps(PI), result),
+                              _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ));
+    __m256 yIsNegative = _mm256_cmp_ps(y, _mm256_setzero_ps(), _CMP_LT_OQ);
+    result = _mm256_xor_ps(result, _mm256_and_ps(yIsNegative, signMask));
+    return result;
+}
+
+// - Same operations as FastTrig_SinTableTurns().
+inline __m256 FastTrig_SinTableTurns8(__m256 turns){
+    turns = _mm256_sub_ps(turns, _mm256_floor_ps(turns));
+    __m256 position = _mm256_mul_ps(turns, _mm256_set1_ps((f32)BINARY_ANGLE_SIN_TABLE_SIZE));
+    __m256i index = _mm256_cvttps_epi32(position);
+    index = _mm256_min_epi32(index, _mm256_set1_epi32(BINARY_ANGLE_SIN_TABLE_SIZE - 1));
+    __m256 frac = _mm256_sub_ps(position, _mm256_cvtepi32_ps(index));
+    __m256 s0 = _mm256_i32gather_ps(fastTrigSinTable.values, index, sizeof(f32));
+    __m256 s1 = _mm256_i32gather_ps(fastTrigSinTable.values + 1, index, sizeof(f32));
+    __m256 result = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_sub_ps(s1, s0), frac));
+    return result;
+}
+
+#define FAST_TRIG_BATCH_WIDTH 8
+#else
+#define FAST_TRIG_BATCH_WIDTH 0
+#endif
+
+
+void FastSinBatch(f32 *in, f32 *out, s32 n){
+    s32 i = 0;
+#if FAST_TRIG_BATCH_WIDTH
+    for(; i + 8 <= n; i += 8){
+        __m256 x = _mm256_loadu_ps(in + i);
+        if (!FastTrig_AreFastInputs8(x)){
+            for(s32 j = i; j < i + 8; j++)
+                out[j] = FastSin(in[j]);
+            continue;
+        }
+        _mm256_storeu_ps(out + i, FastTrig_SinReduced8(FastTrig_Reduce8(x)));
+    }
+#endif
+    for(; i < n; i++)
+        out[i] = FastSin(in[i]);
+}
+
+void FastCosBatch(f32 *in, f32 *out, s32 n){
+    s32 i = 0;
+#if FAST_TRIG_BATCH_WIDTH
+    for(; i + 8 <= n; i += 8){
+        __m256 x = _mm256_loadu_ps(in + i);
+        if (!FastTrig_AreFastInputs8(x)){
+            for(s32 j = i; j < i + 8; j++)
+                out[j] = FastCos(in[j]);
+            continue;
+        }
+        __m256 reduced = FastTrig_Reduce8(x);
+        _mm256_storeu_ps(out + i, FastTrig_SinReduced8(FastTrig_QuarterTurn8(reduced)));
+    }
+#endif
+    for(; i < n; i++)
+        out[i] = FastCos(in[i]);
+}
+
+void FastSinCosBatch(f32 *in, f32 *outSin, f32 *outCos, s32 n){
+    s32 i = 0;
+#if FAST_TRIG_BATCH_WIDTH
+    for(; i + 8 <= n; i += 8){
+        __m256 x = _mm256_loadu_ps(in + i);
+        if (!FastTrig_AreFastInputs8(x)){
+            for(s32 j = i; j < i + 8; j++)
+                FastSinCos(in[j], outSin + j, outCos + j);
+            continue;
+        }
+        __m256 reduced = FastTrig_Reduce8(x);
+        __m256 sin = FastTrig_SinReduced8(reduced);
+        __m256 cos = FastTrig_SinReduced8(FastTrig_QuarterTurn8(reduced));
+        _mm256_storeu_ps(outSin + i, sin);
+        _mm256_storeu_ps(outCos + i, cos);
+    }
+#endif
+    for(; i < n; i++)
+        FastSinCos(in[i], outSin + i, outCos + i);
+}
+
+void FastSinTableBatch(f32 *in, f32 *out, s32 n){
+    s32 i = 0;
+#if FAST_TRIG_BATCH_WIDTH
+    for(; i + 8 <= n; i += 8){
+        __m256 x = _mm256_loadu_ps(in + i);
+        if (!FastTrig_AreFastInputs8(x)){
+            for(s32 j = i; j < i + 8; j++)
+                out[j] = FastSinTable(in[j]);
+            continue;
+        }
+        __m256 turns = _mm256_mul_ps(FastTrig_Reduce8(x), _mm256_set1_ps(FAST_TRIG_INV_TWO_PI));
+        _mm256_storeu_ps(out + i, FastTrig_SinTableTurns8(turns));
+    }
+#endif
+    for(; i < n; i++)
+        out[i] = FastSinTable(in[i]);
+}
+
+void FastCosTableBatch(f32 *in, f32 *out, s32 n){
+    s32 i = 0;
+#if FAST_TRIG_BATCH_WIDTH
+    for(; i + 8 <= n; i += 8){
+        __m256 x = _mm256_loadu_ps(in + i);
+        if (!FastTrig_AreFastInputs8(x)){
+            for(s32 j = i; j < i + 8; j++)
+                out[j] = FastCosTable(in[j]);
+            continue;
+        }
+        __m256 turns = _mm256_mul_ps(FastTrig_Reduce8(x), _mm256_set1_ps(FAST_TRIG_INV_TWO_PI));
+        turns = _mm256_add_ps(turns, _mm256_set1_ps(.25f));
+        _mm256_storeu_ps(out + i, FastTrig_SinTableTurns8(turns));
+    }
+#endif
+    for(; i < n; i++)
+        out[i] = FastCosTable(in[i]);
+}
+
+void FastAtan2Batch(f32 *y, f32 *x, f32 *out, s32 n){
+    s32 i = 0;
+#if FAST_TRIG_BATCH_WIDTH
+    for(; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(out + i, FastAtan2_8(_mm256_loadu_ps(y + i), _mm256_loadu_ps(x + i)));
+#endif
+    for(; i < n; i++)
+        out[i] = FastAtan2(y[i], x[i]);
+}
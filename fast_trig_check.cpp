@@ -0,0 +1,319 @@
+//
+// Checks for fast_trig.cpp: every f32 against f64 libm, and timing of the scalar and batch
+// versions.
+//
+// Has a bit of unincluded context.
+//
+
+/*
+ - FastTrig_Check() goes through the finite f32s in bit order, a block at a time. 'step' 1 is
+   every one of them (4 billion, it takes minutes); bigger steps are quicker and still cover
+   every magnitude. For each block and function it:
+     - Computes the reference in f64 with libm.
+     - Runs the scalar function and the *Batch one, and checks that they give the same bits.
+     - Keeps the max abs error against the reference, separately for the inputs that take the
+       fast path and the ones that go to libm (see FAST_TRIG_MAX_FAST_INPUT).
+
+ - atan2 takes two inputs, so every f32 'v' is checked as (v, 1), (v, -1), (1, v) and (-1, v).
+   That's every octant, and every ratio of y and x that f32 can represent. The reference is plain
+   atan2(), so (-0, -1) is counted apart: FastAtan2 gives PI there on purpose (see the top of
+   fast_trig.cpp), and it's checked against PI. The zeros are also checked on their own
+   (FastTrig_CheckSpecialCases).
+
+ - The timings don't use the sweep: in bit order most inputs are tiny or denormal, which isn't
+   what a game passes (and denormals are slow for everyone). They use angles spread over
+   [-4*PI, 4*PI], and for atan2 directions all around the circle. The libm column is the f64
+   reference.
+*/
+
+enum fast_trig_check_function{
+    FastTrigCheck_Sin,
+    FastTrigCheck_Cos,
+    FastTrigCheck_SinCos,   // Errors of both outputs.
+    FastTrigCheck_SinTable,
+    FastTrigCheck_CosTable,
+    FastTrigCheck_Atan2,
+
+    FastTrigCheck_Count,
+};
+
+struct fast_trig_check_error{
+    f64 maxError;
+    f32 worstInput;         // For atan2, the 'v' (see above).
+};
+
+struct fast_trig_check_report{
+    s64 numInputs;
+    fast_trig_check_error errors[FastTrigCheck_Count];     // Inputs that take the fast path.
+    fast_trig_check_error libmErrors[FastTrigCheck_Count]; // Inputs that go to libm.
+    s64 batchMismatches[FastTrigCheck_Count]; // Batch results that aren't the same bits as the scalar ones.
+    s32 specialCaseFailures;
+    s64 atan2NegativeZeroInputs; // (-0, x < 0): PI instead of libm's -PI, on purpose.
+
+    // Per call (per pair for SinCos), best of a few runs.
+    f64 scalarCycles[FastTrigCheck_Count];
+    f64 batchCycles[FastTrigCheck_Count];
+    f64 libmCycles[FastTrigCheck_Count];
+};
+
+// - 'x' is the second input of atan2 (the first is 'in'), 'out2' the second output of SinCos.
+void FastTrigCheck_Run(fast_trig_check_function function, b32 batch, f32 *in, f32 *x,
+                       f32 *out, f32 *out2, s32 n){
+    switch(function){
+        case FastTrigCheck_Sin:{
+            if (batch){
+                FastSinBatch(in, out, n);
+            }else{
+                for(s32 i = 0; i < n; i++)
+                    out[i] = FastSin(in[i]);
+            }
+        }break;
+        case FastTrigCheck_Cos:{
+            if (batch){
+                FastCosBatch(in, out, n);
+            }else{
+                for(s32 i = 0; i < n; i++)
+                    out[i] = FastCos(in[i]);
+            }
+        }break;
+        case FastTrigCheck_SinCos:{
+            if (batch){
+                FastSinCosBatch(in, out, out2, n);
+            }else{
+                for(s32 i = 0; i < n; i++)
+                    FastSinCos(in[i], &out[i], &out2[i]);
+            }
+        }break;
+        case FastTrigCheck_SinTable:{
+            if (batch){
+                FastSinTableBatch(in, out, n);
+            }else{
+                for(s32 i = 0; i < n; i++)
+                    out[i] = FastSinTable(in[i]);
+            }
+        }break;
+        case FastTrigCheck_CosTable:{
+            if (batch){
+                FastCosTableBatch(in, out, n);
+            }else{
+                for(s32 i = 0; i < n; i++)
+                    out[i] = FastCosTable(in[i]);
+            }
+        }break;
+        case FastTrigCheck_Atan2:{
+            if (batch){
+                FastAtan2Batch(in, x, out, n);
+            }else{
+                for(s32 i = 0; i < n; i++)
+                    out[i] = FastAtan2(in[i], x[i]);
+            }
+        }break;
+        default: InvalidCodepath;
+    }
+}
+
+// - 'x' and 'out2' like FastTrigCheck_Run().
+void FastTrigCheck_Reference(fast_trig_check_function function, f32 *in, f32 *x, f64 *out, f64 *out2, s32 n){
+    switch(function){
+        case FastTrigCheck_Sin:
+        case FastTrigCheck_SinTable:{
+            for(s32 i = 0; i < n; i++)
+                out[i] = sin((f64)in[i]);
+        }break;
+        case FastTrigCheck_Cos:
+        case FastTrigCheck_CosTable:{
+            for(s32 i = 0; i < n; i++)
+                out[i] = cos((f64)in[i]);
+        }break;
+        case FastTrigCheck_SinCos:{
+            for(s32 i = 0; i < n; i++){
+                out[i]  = sin((f64)in[i]);
+                out2[i] = cos((f64)in[i]);
+            }
+        }break;
+        case FastTrigCheck_Atan2:{
+            for(s32 i = 0; i < n; i++)
+                out[i] = atan2((f64)in[i], (f64)x[i]);
+        }break;
+        default: InvalidCodepath;
+    }
+}
+
+inline void FastTrigCheck_AddError(fast_trig_check_error *error, f32 value, f64 reference, f32 input){
+    f64 e = fabs((f64)value - reference);
+    if (e > error->maxError || isnan(e)){
+        error->maxError = (isnan(e) ? INFINITY : e);
+        error->worstInput = input;
+    }
+}
+
+inline s64 FastTrigCheck_CountBitMismatches(f32 *a, f32 *b, s32 n){
+    s64 result = 0;
+    for(s32 i = 0; i < n; i++)
+        result += (memcmp(&a[i], &b[i], sizeof(f32)) != 0);
+    return result;
+}
+
+// - Returns the number of failures.
+s32 FastTrig_CheckSpecialCases(){
+    struct atan2_case{ f32 y, x, expected; };
+    atan2_case cases[] = {
+        { 0.f,  1.f, 0},
+        {-0.f,  1.f, 0},
+        { 0.f, -1.f, PI},
+        {-0.f, -1.f, PI}, // Not -PI like libm: -PI is only for negative y.
+        { 0.f,  0.f, 0},
+        {-0.f, -0.f, 0},  // libm gives -PI.
+        { 1.f,  0.f, FAST_TRIG_HALF_PI},
+        {-1.f,  0.f, -FAST_TRIG_HALF_PI},
+    };
+    s32 numCases = ArrayCount(cases);
+    // 16 so that the batch version goes through its 8-wide path too.
+    f32 ys[16], xs[16], batch[16];
+    for(s32 i = 0; i < 16; i++){
+        ys[i] = cases[i % numCases].y;
+        xs[i] = cases[i % numCases].x;
+    }
+    FastAtan2Batch(ys, xs, batch, 16);
+
+    s32 failures = 0;
+    for(s32 i = 0; i < 16; i++){
+        f32 scalar = FastAtan2(ys[i], xs[i]);
+        f32 expected = cases[i % numCases].expected;
+        if (fabsf(scalar - expected) > 1e-6f || fabsf(batch[i] - expected) > 1e-6f)
+            failures++;
+    }
+
+    f32 notFinite[3] = {INFINITY, -INFINITY, NAN};
+    for(s32 i = 0; i < 3; i++){
+        if (!isnan(FastSin(notFinite[i])) || !isnan(FastCos(notFinite[i])) ||
+            !isnan(FastSinTable(notFinite[i])) || !isnan(FastCosTable(notFinite[i])))
+            failures++;
+    }
+    return failures;
+}
+
+// - 'out' must fit 2*n, 'reference' 2*n, 'in', 'x' and 'atanY' n.
+void FastTrig_CheckTiming(fast_trig_check_report *report, f32 *in, f32 *x, f32 *atanY, f32 *out,
+                          f64 *reference, s32 n){
+    for(s32 i = 0; i < n; i++){
+        f32 t = ((f32)i + .5f)/(f32)n;
+        in[i] = (2*t - 1)*4*PI;
+        // Every direction, at different distances.
+        atanY[i] = sinf(in[i]*.25f)*(1.f + 100.f*t);
+        x[i]     = cosf(in[i]*.25f)*(1.f + 100.f*t);
+    }
+
+    const s32 numRepeats = 16;
+    for(s32 f = 0; f < FastTrigCheck_Count; f++){
+        fast_trig_check_function function = (fast_trig_check_function)f;
+        f32 *functionIn = (function == FastTrigCheck_Atan2 ? atanY : in);
+        u64 best[3] = {}; // Scalar, batch, libm
+        for(s32 repeat = 0; repeat < numRepeats; repeat++){
+            u64 cycles[3];
+            u64 start = __rdtsc();
+            FastTrigCheck_Run(function, false, functionIn, x, out, out + n, n);
+            cycles[0] = __rdtsc() - start;
+            start = __rdtsc();
+            FastTrigCheck_Run(function, true, functionIn, x, out, out + n, n);
+            cycles[1] = __rdtsc() - start;
+            start = __rdtsc();
+            FastTrigCheck_Reference(function, functionIn, x, reference, reference + n, n);
+            cycles[2] = __rdtsc() - start;
+            for(s32 i = 0; i < 3; i++)
+                best[i] = (!repeat || cycles[i] < best[i] ? cycles[i] : best[i]);
+        }
+        report->scalarCycles[f] = (f64)best[0]/(f64)n;
+        report->batchCycles[f]  = (f64)best[1]/(f64)n;
+        report->libmCycles[f]   = (f64)best[2]/(f64)n;
+    }
+}
+
+// - 'step': goes through the f32 bit patterns 0, step, 2*step... (non-finite ones are skipped).
+void FastTrig_Check(fast_trig_check_report *report, u32 step){
+    Assert(step > 0);
+    ZeroStruct(report);
+    report->specialCaseFailures = FastTrig_CheckSpecialCases();
+
+    const s32 blockSize = 4096;
+    f32 *in        = (f32 *)malloc(sizeof(f32)*blockSize*7);
+    f32 *x         = in + blockSize;
+    f32 *atanIn    = x + blockSize;
+    f32 *scalar    = atanIn + blockSize; // 2 blocks: the second one is SinCos's cos.
+    f32 *batch     = scalar + 2*blockSize;
+    f64 *reference = (f64 *)malloc(sizeof(f64)*blockSize*2);
+
+    for(u64 bits = 0; bits <= 0xFFFFFFFF;){
+        s32 n = 0;
+        for(; n < blockSize && bits <= 0xFFFFFFFF; bits += step){
+            u32 pattern = (u32)bits;
+            f32 v;
+            memcpy(&v, &pattern, sizeof(f32));
+            if (!isfinite(v))
+                continue;
+            in[n++] = v;
+        }
+        if (!n)
+            break;
+        report->numInputs += n;
+
+        for(s32 f = 0; f < FastTrigCheck_Count; f++){
+            fast_trig_check_function function = (fast_trig_check_function)f;
+            s32 numParts = (function == FastTrigCheck_Atan2 ? 4 : 1);
+            for(s32 part = 0; part < numParts; part++){
+                f32 *functionIn = in;
+                if (function == FastTrigCheck_Atan2){
+                    // (v, 1), (v, -1), (1, v), (-1, v)
+                    f32 other = ((part & 1) ? -1.f : 1.f);
+                    for(s32 i = 0; i < n; i++){
+                        atanIn[i] = (part < 2 ? in[i] : other);
+                        x[i]      = (part < 2 ? other : in[i]);
+                    }
+                    functionIn = atanIn;
+                }
+
+                FastTrigCheck_Reference(function, functionIn, x, reference, reference + blockSize, n);
+                FastTrigCheck_Run(function, false, functionIn, x, scalar, scalar + blockSize, n);
+                FastTrigCheck_Run(function, true,  functionIn, x, batch,  batch + blockSize,  n);
+
+                s32 numOutputs = (function == FastTrigCheck_SinCos ? 2 : 1);
+                for(s32 output = 0; output < numOutputs; output++){
+                    f32 *scalarOut = scalar + output*blockSize;
+                    f64 *referenceOut = reference + output*blockSize;
+                    report->batchMismatches[f] += FastTrigCheck_CountBitMismatches(scalarOut, batch + output*blockSize, n);
+                    for(s32 i = 0; i < n; i++){
+                        b32 fast = (function == FastTrigCheck_Atan2 || FastTrig_IsFastInput(in[i]));
+                        fast_trig_check_error *errors = (fast ? report->errors : report->libmErrors);
+                        f64 expected = referenceOut[i];
+                        if (function == FastTrigCheck_Atan2 && functionIn[i] == 0 && signbit(functionIn[i]) && x[i] < 0){
+                            report->atan2NegativeZeroInputs++;
+                            expected = -expected; // PI, not libm's -PI.
+                        }
+                        FastTrigCheck_AddError(&errors[f], scalarOut[i], expected, in[i]);
+                    }
+                }
+            }
+        }
+    }
+
+    FastTrig_CheckTiming(report, in, x, atanIn, scalar, reference, blockSize);
+
+    free(in);
+    free(reference);
+}
+
+void FastTrig_CheckPrint(fast_trig_check_report *report){
+    local_persist char *names[FastTrigCheck_Count] = {"FastSin", "FastCos", "FastSinCos", "FastSinTable",
+                                                      "FastCosTable", "FastAtan2"};
+    printf("fast trig: %lld inputs, %d special case failures, %lld atan2 (-0, x < 0) inputs checked against PI\n",
+           (long long)report->numInputs, report->specialCaseFailures, (long long)report->atan2NegativeZeroInputs);
+    printf("%-13s %-24s %-24s %10s   cycles: scalar  batch   libm\n", "", "max error (worst input)",
+           "libm path", "batch diff");
+    for(s32 f = 0; f < FastTrigCheck_Count; f++){
+        printf("%-13s %9.2e (%12.5g) %9.2e (%12.5g) %10lld   %14.2f %6.2f %6.2f\n", names[f],
+               report->errors[f].maxError, report->errors[f].worstInput,
+               report->libmErrors[f].maxError, report->libmErrors[f].worstInput,
+               (long long)report->batchMismatches[f], report->scalarCycles[f],
+               report->batchCycles[f], report->libmCycles[f]);
+    }
+}
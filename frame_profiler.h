@@ -0,0 +1,295 @@
+//
+// Frame profiler
+//
+// Has a bit of unincluded context.
+//
+
+/*
+ - Put TIMED_FUNCTION() (or TIMED_BLOCK("name")) at the start of a scope and it measures that scope
+   with __rdtsc(). Compile with FRAME_PROFILER 1 to turn it on; with 0 (the default) the macros
+   are empty, so it costs nothing in release builds.
+
+ - Each thread writes only to its own buffer (allocated the first time it enters a block), so
+   there are no locks or atomics while timing. Every block adds a begin and an end event (for the
+   trace) and adds to its hit count and cycles (for the table).
+
+ - Call FrameProfiler_EndFrame() once per frame, from the main thread, outside of any timed block,
+   and when no other thread is inside one (e.g. after the work queue is done). It adds up the
+   counts of all threads in frameProfiler.lastFrame (the per-frame table), writes the events to
+   the trace if there's a capture going, and clears the buffers.
+
+ - Captures: FrameProfiler_BeginCapture("capture.json"), some frames, FrameProfiler_EndCapture().
+   The file is Chrome trace JSON: open it in chrome://tracing or ui.perfetto.dev.
+
+ - Each TIMED_BLOCK gets its site index the first time it runs, from a static next to it
+   (FrameProfiler_RegisterSite), so it works across translation units. A TIMED_BLOCK in a template
+   or an inline function follows the language rules for statics: every template instantiation is
+   a separate site (with the same name and line), and an inline function is one site everywhere.
+
+ - If a thread fills its event buffer, the next blocks of that frame are still counted in the
+   table but don't get events (see 'droppedBlocks'). Tiny hot functions can do that in busy
+   frames, so they aren't instrumented: CircleWallCollision() and HashTable_Get/Add/Remove... only
+   the code that calls them.
+*/
+
+#ifndef FRAME_PROFILER
+#define FRAME_PROFILER 0
+#endif
+
+#define FRAME_PROFILER_MAX_THREADS 32
+#define FRAME_PROFILER_MAX_SITES   256     // TIMED_BLOCKs that ran, in the whole program.
+#define FRAME_PROFILER_MAX_EVENTS  (1 << 16) // Per thread, per frame.
+
+enum profiler_event_type{
+    ProfilerEvent_Begin,
+    ProfilerEvent_End,
+};
+
+struct profiler_event{
+    u64 clock;
+    u16 siteIndex;
+    u16 type;
+};
+
+struct profiler_site{
+    char *name;
+    char *file;
+    s32 line;
+};
+
+struct profiler_site_counts{
+    u64 hitCount;
+    u64 cycles;     // Including nested blocks.
+};
+
+struct profiler_thread{
+    s32 threadIndex;
+    s32 openBlocks;     // Each one needs room for its end event.
+    s32 numEvents;
+    s32 droppedBlocks;  // This frame
+    profiler_event events[FRAME_PROFILER_MAX_EVENTS];
+    profiler_site_counts counts[FRAME_PROFILER_MAX_SITES];
+};
+
+struct frame_profiler{
+    profiler_site sites[FRAME_PROFILER_MAX_SITES];
+    volatile s32 numSites;
+    profiler_thread *threads[FRAME_PROFILER_MAX_THREADS];
+    volatile s32 numThreads;
+
+    u64 frameStartClock;
+    s32 frameIndex;
+
+    // Per-frame table: all threads added up. Only valid after the first FrameProfiler_EndFrame().
+    profiler_site_counts lastFrame[FRAME_PROFILER_MAX_SITES];
+    u64 lastFrameCycles;
+    s32 lastFrameDroppedBlocks;
+
+    // Capture
+    FILE *captureFile;
+    u64 captureStartClock;
+    f64 captureMicrosecondsPerCycle; // From the first frame of the capture, so time never goes back.
+    b32 captureHasEvents; // For the commas.
+};
+
+global_variable frame_profiler frameProfiler;
+thread_local profiler_thread *profilerThread;
+
+
+profiler_thread *FrameProfiler_RegisterThread(){
+    s32 threadIndex = _InterlockedIncrement((volatile long *)&frameProfiler.numThreads) - 1;
+    Assert(threadIndex < FRAME_PROFILER_MAX_THREADS);
+    profiler_thread *thread = (profiler_thread *)malloc(sizeof(profiler_thread));
+    ZeroStruct(thread);
+    thread->threadIndex = threadIndex;
+    frameProfiler.threads[threadIndex] = thread;
+    return thread;
+}
+
+// - Called once per TIMED_BLOCK, to initialize its static site index.
+u16 FrameProfiler_RegisterSite(char *name, char *file, s32 line){
+    s32 siteIndex = _InterlockedIncrement((volatile long *)&frameProfiler.numSites) - 1;
+    Assert(siteIndex < FRAME_PROFILER_MAX_SITES);
+    profiler_site *site = &frameProfiler.sites[siteIndex];
+    site->name = name;
+    site->file = file;
+    site->line = line;
+    return (u16)siteIndex;
+}
+
+struct profiler_timed_block{
+    profiler_thread *thread;
+    u64 startClock;
+    u16 siteIndex;
+    b32 hasEvents;
+
+    profiler_timed_block(u16 siteIndexInit){
+        siteIndex = siteIndexInit;
+
+        thread = profilerThread;
+        if (!thread)
+            thread = profilerThread = FrameProfiler_RegisterThread();
+
+        hasEvents = (thread->numEvents + thread->openBlocks + 2 <= FRAME_PROFILER_MAX_EVENTS);
+        if (!hasEvents)
+            thread->droppedBlocks++;
+        thread->openBlocks++;
+
+        startClock = __rdtsc();
+        if (hasEvents){
+            profiler_event *event = &thread->events[thread->numEvents++];
+            event->clock = startClock;
+            event->siteIndex = siteIndex;
+            event->type = ProfilerEvent_Begin;
+        }
+    }
+
+    ~profiler_timed_block(){
+        u64 endClock = __rdtsc();
+        if (hasEvents){
+            profiler_event *event = &thread->events[thread->numEvents++];
+            event->clock = endClock;
+            event->siteIndex = siteIndex;
+            event->type = ProfilerEvent_End;
+        }
+        thread->openBlocks--;
+        thread->counts[siteIndex].hitCount++;
+        thread->counts[siteIndex].cycles += endClock - startClock;
+    }
+};
+
+// (Headers that can be used without this one define empty ones.)
+#undef TIMED_BLOCK
+#undef TIMED_FUNCTION
+#if FRAME_PROFILER
+#define TIMED_BLOCK__(name, number) \
+    local_persist u16 timedBlockSite_##number = FrameProfiler_RegisterSite((char *)(name), (char *)__FILE__, __LINE__); \
+    profiler_timed_block timedBlock_##number(timedBlockSite_##number)
+#define TIMED_BLOCK_(name, number) TIMED_BLOCK__(name, number)
+#define TIMED_BLOCK(name) TIMED_BLOCK_(name, __LINE__)
+#define TIMED_FUNCTION() TIMED_BLOCK_(__FUNCTION__, __LINE__)
+#else
+#define TIMED_BLOCK(name)
+#define TIMED_FUNCTION()
+#endif
+
+
+// - Returns false if the file couldn't be opened.
+b32 FrameProfiler_BeginCapture(char *path){
+    Assert(!frameProfiler.captureFile);
+    frameProfiler.captureFile = fopen(path, "wb");
+    if (!frameProfiler.captureFile)
+        return false;
+    frameProfiler.captureStartClock = frameProfiler.frameStartClock;
+    frameProfiler.captureMicrosecondsPerCycle = 0;
+    frameProfiler.captureHasEvents = false;
+    fprintf(frameProfiler.captureFile, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    return true;
+}
+
+// - Returns false if there was an error writing the file.
+b32 FrameProfiler_EndCapture(){
+    FILE *file = frameProfiler.captureFile;
+    if (!file)
+        return false;
+    fprintf(file, "\n]}\n");
+    b32 ok = !ferror(file);
+    ok = (fclose(file) == 0) && ok;
+    frameProfiler.captureFile = 0;
+    return ok;
+}
+
+// - As a JSON string, with quotes. Names come from the code (TIMED_BLOCK, __FUNCTION__), but
+//   they can still have quotes or backslashes (e.g. operator"" or file paths).
+void FrameProfiler_WriteJsonString(FILE *file, char *string){
+    fputc('"', file);
+    for(char *c = string; *c; c++){
+        if (*c == '"' || *c == '\\')
+            fprintf(file, "\\%c", *c);
+        else if ((u8)*c < 0x20)
+            fprintf(file, "\\u%04x", (u8)*c);
+        else
+            fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+void FrameProfiler_WriteEvents(profiler_thread *thread){
+    FILE *file = frameProfiler.captureFile;
+    f64 microsecondsPerCycle = frameProfiler.captureMicrosecondsPerCycle;
+    for(s32 i = 0; i < thread->numEvents; i++){
+        profiler_event *event = &thread->events[i];
+        profiler_site *site = &frameProfiler.sites[event->siteIndex];
+        // Events from before the capture started (blocks that were open) are clamped to its start.
+        u64 clock = (event->clock > frameProfiler.captureStartClock ? event->clock : frameProfiler.captureStartClock);
+        f64 timestamp = (f64)(clock - frameProfiler.captureStartClock)*microsecondsPerCycle;
+        fprintf(file, "%s{\"name\":", (frameProfiler.captureHasEvents ? ",\n" : ""));
+        FrameProfiler_WriteJsonString(file, site->name);
+        fprintf(file, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":0,\"tid\":%d}",
+                (event->type == ProfilerEvent_Begin ? 'B' : 'E'), timestamp, thread->threadIndex);
+        frameProfiler.captureHasEvents = true;
+    }
+}
+
+// - 'frameSeconds': how long the frame took, from the platform's timer. It's used to convert
+//   cycles to time for the trace, so it doesn't have to be precise.
+void FrameProfiler_EndFrame(f32 frameSeconds){
+    u64 now = __rdtsc();
+    frameProfiler.lastFrameCycles = now - frameProfiler.frameStartClock;
+    if (frameProfiler.captureFile && !frameProfiler.captureMicrosecondsPerCycle &&
+        frameProfiler.frameStartClock && frameProfiler.lastFrameCycles){
+        frameProfiler.captureMicrosecondsPerCycle = (f64)frameSeconds*1000000.0/(f64)frameProfiler.lastFrameCycles;
+    }
+
+    ZeroStruct(&frameProfiler.lastFrame);
+    frameProfiler.lastFrameDroppedBlocks = 0;
+    for(s32 threadIndex = 0; threadIndex < frameProfiler.numThreads; threadIndex++){
+        profiler_thread *thread = frameProfiler.threads[threadIndex];
+        if (!thread) // Registered but not written yet.
+            continue;
+        for(s32 site = 0; site < FRAME_PROFILER_MAX_SITES; site++){
+            frameProfiler.lastFrame[site].hitCount += thread->counts[site].hitCount;
+            frameProfiler.lastFrame[site].cycles   += thread->counts[site].cycles;
+        }
+        frameProfiler.lastFrameDroppedBlocks += thread->droppedBlocks;
+
+        if (frameProfiler.captureFile)
+            FrameProfiler_WriteEvents(thread);
+
+        thread->numEvents = 0;
+        thread->droppedBlocks = 0;
+        ZeroStruct(&thread->counts);
+    }
+
+    frameProfiler.frameIndex++;
+    frameProfiler.frameStartClock = now;
+}
+
+// - Writes the per-frame table of the last frame, most expensive first.
+void FrameProfiler_PrintLastFrame(FILE *file){
+    u16 order[FRAME_PROFILER_MAX_SITES];
+    s32 numSites = 0;
+    for(s32 site = 0; site < FRAME_PROFILER_MAX_SITES; site++){
+        if (!frameProfiler.lastFrame[site].hitCount)
+            continue;
+        // Insertion by cycles, descending.
+        s32 i = numSites++;
+        for(; i > 0 && frameProfiler.lastFrame[order[i - 1]].cycles < frameProfiler.lastFrame[site].cycles; i--){
+            order[i] = order[i - 1];
+        }
+        order[i] = (u16)site;
+    }
+
+    fprintf(file, "Frame %d: %llu cycles, %d blocks without events\n", frameProfiler.frameIndex,
+            (unsigned long long)frameProfiler.lastFrameCycles, frameProfiler.lastFrameDroppedBlocks);
+    fprintf(file, "%14s %10s %12s %7s  %s\n", "cycles", "hits", "cycles/hit", "frame%", "block");
+    for(s32 i = 0; i < numSites; i++){
+        profiler_site *site = &frameProfiler.sites[order[i]];
+        profiler_site_counts *counts = &frameProfiler.lastFrame[order[i]];
+        f64 framePercent = (frameProfiler.lastFrameCycles ?
+                            100.0*(f64)counts->cycles/(f64)frameProfiler.lastFrameCycles : 0);
+        fprintf(file, "%14llu %10llu %12.1f %6.2f%%  %s (%s:%d)\n", (unsigned long long)counts->cycles,
+                (unsigned long long)counts->hitCount, (f64)counts->cycles/(f64)counts->hitCount,
+                framePercent, site->name, site->file, site->line);
+    }
+}
@@ -4,6 +4,12 @@
 // Has a tiny bit of unincluded context.
 //
 
+// Only Resize and Clear are timed (include frame_profiler.h first): the other operations are too
+// short for a timer, and every hash_table<T> instantiation has its own profiler sites.
+#ifndef TIMED_FUNCTION
+#define TIMED_FUNCTION()
+#endif
+
 
 // - If C is equal to A or B, this results in false.
 // - Otherwise, if A==B this results in true.
@@ -168,7 +174,7 @@ inline void HashTable_AssertValidType(hash_table<T> *table){
 
 template <typename T>
 inline void HashTable_InitFromMemory(hash_table<T> *table, T *mem, s32 totalSlots){
-    Assert(initialNumSlots >= 10);
+    Assert(totalSlots >= 10);
     HashTable_AssertValidType(table);                                                       
 
     table->totalSlots = totalSlots;
@@ -255,6 +261,7 @@ inline T *HashTable_AddNoResize(hash_table<T> *table, K key){
 
 template <typename T>
 void HashTable_Resize(hash_table<T> *table, s32 newTotalSlots){
+    TIMED_FUNCTION();
     Assert(newTotalSlots > table->totalSlots);
     hash_table<T> oldTable = *table;
 
@@ -456,6 +463,7 @@ b32 HashTable_Remove(hash_table<T> *table, K key){
 
 template <typename T>
 void HashTable_Clear(hash_table<T> *table){
+    TIMED_FUNCTION();
     Assert(table->mem);
     T *it = (T *)table->mem;
     T *limit = (T *)table->mem + table->totalSlots;
@@ -468,11 +476,13 @@ void HashTable_Clear(hash_table<T> *table){
 
 template <typename T>
 // USAGE WARNING: CALLING THIS CAN INVALIDATE ALL ELEMENT POINTERS.
-b32 HashTable_ResizeIfNeeded(hash_table<T>){
+b32 HashTable_ResizeIfNeeded(hash_table<T> *table){
     Assert(table->mem);
     if (table->occupiedSlots > (s32)(table->totalSlots*HASHTABLE_MAX_FILLED_FACTOR)){
         s32 newTotalSlots = table->totalSlots << 1;
         HashTable_Resize(table, newTotalSlots);
+        return true;
     }
+    return false;
 }
 
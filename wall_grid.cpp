@@ -0,0 +1,185 @@
+//
+// Broadphase for CircleWallCollision (circle_wall_collision.cpp): a static uniform grid over the
+// walls of a level, built at level load. Queries only look at the cells that the circle touches,
+// instead of every wall in the area.
+//
+// Has a little bit of unincluded context.
+//
+
+/*
+ - Cells are squares of 'cellSize' aligned to multiples of 'cellSize' in world coordinates, so if
+   you use the chunk size they line up with the world's chunks.
+
+ - Each cell stores an entry for every wall whose AABB overlaps it, with a copy of that AABB, so
+   most rejections don't have to touch the wall itself.
+
+ - A wall that overlaps many cells is only tested in the first cell (lowest x and y) of the
+   query that it overlaps. That way queries don't need any "already visited" state, and many
+   threads can query the same grid.
+
+ - The grid doesn't own the walls. If you move or delete them, build it again.
+*/
+
+struct wall_grid_entry{
+    v2s min; // Wall AABB.
+    v2s max;
+    s32 wallIndex;
+};
+
+struct wall_grid{
+    wall *walls;
+    s32 numWalls;
+
+    s32 cellSize;
+    v2s cellMin;   // Cell coordinates of cell 0.
+    s32 width;     // In cells.
+    s32 height;
+
+    s32 *cellFirstEntry; // width*height + 1 offsets into 'entries'.
+    wall_grid_entry *entries;
+};
+
+
+inline s32 WallGrid_FloorDiv(s32 a, s32 b){
+    s32 result = a/b - (a % b < 0);
+    return result;
+}
+
+inline v2s WallGrid_WorldToCell(wall_grid *grid, v2s p){
+    v2s result = {WallGrid_FloorDiv(p.x, grid->cellSize), WallGrid_FloorDiv(p.y, grid->cellSize)};
+    return result;
+}
+
+// - Cell range of the grid that overlaps the world rect 'min' to 'max' (inclusive). The result can be
+//   empty (max < min) if the rect is outside the grid.
+inline void WallGrid_CellRange(wall_grid *grid, v2s min, v2s max, v2s *outCellMin, v2s *outCellMax){
+    v2s cellMin = WallGrid_WorldToCell(grid, min) - grid->cellMin;
+    v2s cellMax = WallGrid_WorldToCell(grid, max) - grid->cellMin;
+    outCellMin->x = MaxS32(cellMin.x, 0);
+    outCellMin->y = MaxS32(cellMin.y, 0);
+    outCellMax->x = MinS32(cellMax.x, grid->width - 1);
+    outCellMax->y = MinS32(cellMax.y, grid->height - 1);
+}
+
+void WallGrid_Build(wall_grid *grid, wall *walls, s32 numWalls, s32 cellSize){
+    Assert(cellSize > 0);
+    ZeroStruct(grid);
+    grid->walls = walls;
+    grid->numWalls = numWalls;
+    grid->cellSize = cellSize;
+
+    // Grid bounds
+    v2s worldMin = V2S(S32_MAX);
+    v2s worldMax = V2S(S32_MIN);
+    for(s32 i = 0; i < numWalls; i++){
+        for(s32 j = 0; j < 3; j++){
+            worldMin = MinV2S(worldMin, walls[i].p[j]);
+            worldMax = MaxV2S(worldMax, walls[i].p[j]);
+        }
+    }
+    if (!numWalls){
+        worldMin = worldMax = V2S(0);
+    }
+    grid->cellMin = WallGrid_WorldToCell(grid, worldMin);
+    v2s cellMax = WallGrid_WorldToCell(grid, worldMax);
+    grid->width  = cellMax.x - grid->cellMin.x + 1;
+    grid->height = cellMax.y - grid->cellMin.y + 1;
+
+    s32 numCells = grid->width*grid->height;
+    grid->cellFirstEntry = (s32 *)malloc(sizeof(s32)*(numCells + 1));
+    ZeroSize(grid->cellFirstEntry, sizeof(s32)*(numCells + 1));
+
+    // Count entries per cell (in cellFirstEntry[cell + 1]).
+    s32 numEntries = 0;
+    for(s32 i = 0; i < numWalls; i++){
+        wall *w = &walls[i];
+        v2s cellMin, cellMax;
+        WallGrid_CellRange(grid, MinV2S(MinV2S(w->p[0], w->p[1]), w->p[2]),
+                           MaxV2S(MaxV2S(w->p[0], w->p[1]), w->p[2]), &cellMin, &cellMax);
+        for(s32 y = cellMin.y; y <= cellMax.y; y++){
+            for(s32 x = cellMin.x; x <= cellMax.x; x++){
+                grid->cellFirstEntry[y*grid->width + x + 1]++;
+                numEntries++;
+            }
+        }
+    }
+    for(s32 cell = 0; cell < numCells; cell++){
+        grid->cellFirstEntry[cell + 1] += grid->cellFirstEntry[cell];
+    }
+    Assert(grid->cellFirstEntry[numCells] == numEntries);
+
+    // Fill. We advance cellFirstEntry[cell] as we go, and then shift everything back one cell.
+    grid->entries = (wall_grid_entry *)malloc(sizeof(wall_grid_entry)*MaxS32(numEntries, 1));
+    for(s32 i = 0; i < numWalls; i++){
+        wall *w = &walls[i];
+        wall_grid_entry entry;
+        entry.min = MinV2S(MinV2S(w->p[0], w->p[1]), w->p[2]);
+        entry.max = MaxV2S(MaxV2S(w->p[0], w->p[1]), w->p[2]);
+        entry.wallIndex = i;
+
+        v2s cellMin, cellMax;
+        WallGrid_CellRange(grid, entry.min, entry.max, &cellMin, &cellMax);
+        for(s32 y = cellMin.y; y <= cellMax.y; y++){
+            for(s32 x = cellMin.x; x <= cellMax.x; x++){
+                grid->entries[grid->cellFirstEntry[y*grid->width + x]++] = entry;
+            }
+        }
+    }
+    for(s32 cell = numCells; cell > 0; cell--){
+        grid->cellFirstEntry[cell] = grid->cellFirstEntry[cell - 1];
+    }
+    grid->cellFirstEntry[0] = 0;
+}
+
+void WallGrid_Destruct(wall_grid *grid){
+    free(grid->cellFirstEntry);
+    free(grid->entries);
+    ZeroStruct(grid);
+}
+
+// - Writes to 'outWalls' the walls that collide with the circle (up to 'maxWalls').
+// - Returns the number of walls written.
+s32 WallGrid_CircleWallCollisions(wall_grid *grid, v2s center, s32 radius, wall **outWalls, s32 maxWalls){
+    TIMED_FUNCTION();
+    Assert(maxWalls > 0);
+    v2s queryMin = center - V2S(radius);
+    v2s queryMax = center + V2S(radius);
+    v2s cellMin, cellMax;
+    WallGrid_CellRange(grid, queryMin, queryMax, &cellMin, &cellMax);
+
+    s32 count = 0;
+    for(s32 y = cellMin.y; y <= cellMax.y; y++){
+        for(s32 x = cellMin.x; x <= cellMax.x; x++){
+            s32 cell = y*grid->width + x;
+            wall_grid_entry *entry = grid->entries + grid->cellFirstEntry[cell];
+            wall_grid_entry *end   = grid->entries + grid->cellFirstEntry[cell + 1];
+            for(; entry < end; entry++){
+                // Wall AABB grown by radius doesn't contain the center.
+                if (entry->min.x > queryMax.x || entry->max.x < queryMin.x ||
+                    entry->min.y > queryMax.y || entry->max.y < queryMin.y)
+                    continue;
+
+                // Only test it in the first cell of this query that it overlaps.
+                v2s entryCellMin, entryCellMax;
+                WallGrid_CellRange(grid, entry->min, entry->max, &entryCellMin, &entryCellMax);
+                if (MaxS32(entryCellMin.x, cellMin.x) != x || MaxS32(entryCellMin.y, cellMin.y) != y)
+                    continue;
+
+                wall *w = &grid->walls[entry->wallIndex];
+                if (CircleWallCollision(w, center, radius)){
+                    outWalls[count++] = w;
+                    if (count == maxWalls)
+                        return count;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+// - Returns the first wall found that collides with the circle, or 0 if none.
+wall *WallGrid_CircleWallCollision(wall_grid *grid, v2s center, s32 radius){
+    wall *result = 0;
+    WallGrid_CircleWallCollisions(grid, center, radius, &result, 1);
+    return result;
+}